@@ -0,0 +1,153 @@
+#include "bpt_test.h"
+#include "test_util.h"
+
+#include "core.h"
+#include "trb_set.h"
+
+#include <set>
+#include <vector>
+#include <random>
+#include <numeric>
+#include <cassert>
+#include <iterator>
+#include <iostream>
+#include <algorithm>
+
+
+namespace
+{
+    template<class key_t, bool multi, u32 fanout>
+    using BTree = bpt::Tree<bpt::TreeTraits<key_t, std::less<key_t>, trb::DefaultAllocator, multi, fanout>>;
+
+    template<class SetT, class RefT>
+    void test_random(std::minstd_rand& gen, u32 range, u32 ops)
+    {
+        SetT s;
+        RefT ref;
+        for (u32 i = 0; i < ops; i++)
+        {
+            u32 key = gen() % range;
+            switch (gen() % 4)
+            {
+                case 0:
+                case 1:
+                {
+                    auto refSize = ref.size();
+                    ref.insert(key);
+
+                    auto [it, inserted] = s.insert(key);
+                    assert(inserted == (ref.size() != refSize));
+                    assert(*it == key);
+                    break;
+                }
+                case 2:
+                {
+                    // NOTE : tree erases only one of equal keys
+                    s.erase(key);
+                    if (auto it = ref.find(key); it != ref.end())
+                        ref.erase(it);
+                    break;
+                }
+                case 3:
+                {
+                    auto lb = s.lowerBound(key);
+                    auto ub = s.upperBound(key);
+                    auto refLb = ref.lower_bound(key);
+                    auto refUb = ref.upper_bound(key);
+                    assert((lb == s.end()) == (refLb == ref.end()));
+                    assert((ub == s.end()) == (refUb == ref.end()));
+                    assert(lb == s.end() || *lb == *refLb);
+                    assert(ub == s.end() || *ub == *refUb);
+                    assert(ub - lb == std::distance(refLb, refUb));
+                    assert(s.contains(key) == (ref.count(key) != 0));
+                    break;
+                }
+            }
+        }
+        assert(s.invariant());
+        assert(s.size() == ref.size());
+        assert(std::equal(s.begin(), s.end(), ref.begin(), ref.end()));
+
+        // backward iteration
+        auto it = s.end();
+        for (auto refIt = ref.rbegin(); refIt != ref.rend(); ++refIt)
+            assert(*--it == *refIt);
+        assert(it == s.begin());
+
+        // erase everything by iterators
+        while (!s.empty())
+        {
+            auto pos = s.begin();
+            for (u32 k = gen() % s.size(); k > 0; k--)
+                ++pos;
+            s.erase(pos);
+        }
+        assert(s.invariant());
+    }
+}
+
+void test_bpt_set()
+{
+    std::cout << "*************************" << std::endl;
+    std::cout << "**** testing B+-tree ****" << std::endl;
+    std::cout << "*************************" << std::endl;
+
+    std::random_device device;
+    auto seed = device();
+    std::minstd_rand gen(seed);
+
+    std::cout << "seed: " << seed << std::endl;
+
+    for (u32 range : {10u, 100u, 10000u})
+    {
+        test_random<BTree<u32, false, 4>, std::set<u32>>(gen, range, 20000);
+        test_random<BTree<u32, true, 4>, std::multiset<u32>>(gen, range, 20000);
+        test_random<BTree<u32, false, 5>, std::set<u32>>(gen, range, 20000);
+        test_random<BTree<u32, true, 5>, std::multiset<u32>>(gen, range, 20000);
+        test_random<ds::BTreeSet<u32>, std::set<u32>>(gen, range, 20000);
+        test_random<ds::BTreeMultiset<u32>, std::multiset<u32>>(gen, range, 20000);
+    }
+
+    std::cout << "testing ended" << std::endl << std::endl;
+}
+
+void test_bpt_assign_sorted()
+{
+    std::cout << "**************************************" << std::endl;
+    std::cout << "**** testing B+-tree sorted build ****" << std::endl;
+    std::cout << "**************************************" << std::endl;
+
+    std::minstd_rand gen(12345);
+
+    for (u32 count : {0u, 1u, 3u, 4u, 5u, 16u, 17u, 100u, 1000u, 100000u})
+    {
+        std::vector<u32> keys(count);
+        std::iota(keys.begin(), keys.end(), 0);
+
+        BTree<u32, false, 4> small(trb::sorted, keys.begin(), keys.end());
+        assert(small.invariant());
+        assert(std::equal(small.begin(), small.end(), keys.begin(), keys.end()));
+
+        ds::BTreeSet<u32> s(trb::sorted, keys.begin(), keys.end());
+        assert(s.invariant());
+        assert(std::equal(s.begin(), s.end(), keys.begin(), keys.end()));
+
+        // tree stays valid after modifications
+        shuffle(keys, gen);
+        for (u32 i = 0; i < count / 2; i++)
+        {
+            small.erase(keys[i]);
+            s.erase(keys[i]);
+        }
+        for (u32 i = 0; i < count / 4; i++)
+        {
+            small.insert(keys[i]);
+            s.insert(keys[i]);
+        }
+        assert(small.invariant());
+        assert(s.invariant());
+        assert(s.size() == count - count / 2 + count / 4);
+    }
+
+    std::cout << "testing ended" << std::endl << std::endl;
+}
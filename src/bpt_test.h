@@ -0,0 +1,6 @@
+#pragma once
+
+
+void test_bpt_set();
+
+void test_bpt_assign_sorted();
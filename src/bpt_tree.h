@@ -0,0 +1,832 @@
+#pragma once
+
+#include "core.h"
+#include "trb_tree.h"
+
+#include <vector>
+#include <utility>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+
+// B+-tree with the same basic interface as trb::Tree
+// keys are kept in sorted contiguous arrays in leaves, leaves are linked into a list for iteration,
+// inner nodes keep copies of keys as separators: all keys of children[i] are not greater than keys[i]
+// and all keys of children[i + 1] are not less than keys[i]
+namespace bpt
+{
+    // NOTE : keys of a node take about four cache lines
+    template<class key_t>
+    inline constexpr const u32 default_fanout = std::clamp<u32>((u32)(256 / sizeof(key_t)), 16u, 64u);
+
+    template<class key_t, class compare_t, template<class> class allocator_t, bool multi_v, u32 fanout_v = default_fanout<key_t>>
+    struct TreeTraits
+    {
+        static constexpr const bool multi = multi_v;
+        static constexpr const u32 fanout = fanout_v;
+
+        using Key     = key_t;
+        using Compare = compare_t;
+
+        template<class T>
+        using Allocator = allocator_t<T>;
+    };
+
+    // TODO : const iterator
+    // NOTE : any insertion or erasure invalidates all iterators (keys are shifted inside of the arrays)
+    template<class tree_traits_t>
+    class Tree
+    {
+    public:
+        using Key     = typename tree_traits_t::Key;
+        using Compare = typename tree_traits_t::Compare;
+
+        static constexpr const u32 fanout   = tree_traits_t::fanout;
+        static constexpr const u32 min_fill = fanout / 2;
+
+        static_assert(fanout >= 4, "Fanout is too small.");
+
+    private:
+        struct Inner;
+
+        // NOTE : count is count of keys for a leaf and count of children for an inner node
+        struct Node
+        {
+            Inner* parent{};
+            u32 count{};
+            bool leaf{};
+        };
+
+        // NOTE : all nodes have one extra slot so that they can overflow right before split
+        struct Leaf : Node
+        {
+            Leaf* prev{};
+            Leaf* next{};
+            Key keys[fanout + 1]{};
+        };
+
+        struct Inner : Node
+        {
+            Key keys[fanout]{};
+            Node* children[fanout + 1]{};
+        };
+
+        using LeafAllocator  = typename tree_traits_t::template Allocator<Leaf>;
+        using InnerAllocator = typename tree_traits_t::template Allocator<Inner>;
+
+    public:
+        class Iterator
+        {
+            friend class Tree;
+
+        public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = Key;
+            using reference  = Key&;
+            using pointer    = Key*;
+            using difference_type = std::ptrdiff_t;
+
+
+        private:
+            Iterator(Tree* tree, Leaf* leaf, u32 index) : m_tree{tree}, m_leaf{leaf}, m_index{index}
+            {}
+
+        public:
+            Iterator() = default;
+
+
+        public:
+            reference operator * () const
+            {
+                assert(m_leaf != nullptr);
+
+                return m_leaf->keys[m_index];
+            }
+
+            pointer operator -> () const
+            {
+                assert(m_leaf != nullptr);
+
+                return &m_leaf->keys[m_index];
+            }
+
+            // NOTE : end() is decremented to the last key
+            Iterator& operator -- ()
+            {
+                if (m_leaf == nullptr)
+                {
+                    m_leaf  = m_tree->m_last;
+                    m_index = m_leaf->count;
+                }
+                else if (m_index == 0)
+                {
+                    m_leaf  = m_leaf->prev;
+                    m_index = m_leaf->count;
+                }
+                --m_index;
+
+                return *this;
+            }
+
+            Iterator& operator ++ ()
+            {
+                assert(m_leaf != nullptr);
+
+                if (++m_index == m_leaf->count)
+                {
+                    m_leaf  = m_leaf->next;
+                    m_index = 0;
+                }
+
+                return *this;
+            }
+
+            Iterator operator -- (int)
+            {
+                auto it{*this};
+
+                return --(*this), it;
+            }
+
+            Iterator operator ++ (int)
+            {
+                auto it{*this};
+
+                return ++(*this), it;
+            }
+
+            // NOTE : it must precede this iterator, O(distance / fanout)
+            difference_type operator - (Iterator it) const
+            {
+                difference_type diff = 0;
+                while (it.m_leaf != m_leaf)
+                {
+                    diff += it.m_leaf->count - it.m_index;
+                    it.m_leaf  = it.m_leaf->next;
+                    it.m_index = 0;
+                }
+                return diff + m_index - it.m_index;
+            }
+
+
+            bool operator == (Iterator it) const
+            {
+                return m_leaf == it.m_leaf && m_index == it.m_index;
+            }
+
+            bool operator != (Iterator it) const
+            {
+                return !(*this == it);
+            }
+
+
+        protected:
+            Tree* m_tree{nullptr};
+            Leaf* m_leaf{nullptr};
+            u32 m_index{};
+        };
+
+
+    public:
+        Tree() = default;
+
+        Tree(Compare&& compare) : m_compare(std::move(compare))
+        {}
+
+        Tree(const Compare& compare) : m_compare(compare)
+        {}
+
+        template<class It>
+        Tree(trb::SortedTag, It first, It last)
+        {
+            assignSorted(first, last);
+        }
+
+        Tree(const Tree&) = delete;
+
+        Tree(Tree&& another) noexcept
+            : m_root{std::exchange(another.m_root, nullptr)}
+            , m_first{std::exchange(another.m_first, nullptr)}
+            , m_last{std::exchange(another.m_last, nullptr)}
+            , m_size{std::exchange(another.m_size, 0u)}
+            , m_compare{std::move(another.m_compare)}
+            , m_leafAllocator{std::move(another.m_leafAllocator)}
+            , m_innerAllocator{std::move(another.m_innerAllocator)}
+        {}
+
+        ~Tree()
+        {
+            clear();
+        }
+
+        Tree& operator = (const Tree&) = delete;
+
+        Tree& operator = (Tree&& another) noexcept
+        {
+            if (this != &another)
+            {
+                clear();
+
+                m_root  = std::exchange(another.m_root, nullptr);
+                m_first = std::exchange(another.m_first, nullptr);
+                m_last  = std::exchange(another.m_last, nullptr);
+                m_size  = std::exchange(another.m_size, 0u);
+
+                m_compare        = std::move(another.m_compare);
+                m_leafAllocator  = std::move(another.m_leafAllocator);
+                m_innerAllocator = std::move(another.m_innerAllocator);
+            }
+            return *this;
+        }
+
+
+    private: // search
+        template<class key_t>
+        u32 lowerIndex(const Key* keys, u32 count, const key_t& key)
+        {
+            return (u32)(std::lower_bound(keys, keys + count, key, [&] (const Key& a, const key_t& b) {return m_compare(a, b);}) - keys);
+        }
+
+        template<class key_t>
+        u32 upperIndex(const Key* keys, u32 count, const key_t& key)
+        {
+            return (u32)(std::upper_bound(keys, keys + count, key, [&] (const key_t& a, const Key& b) {return m_compare(a, b);}) - keys);
+        }
+
+        // NOTE : leaf that contains lower bound of the key or whose next leaf starts with it
+        template<class key_t>
+        Leaf* descendLB(const key_t& key)
+        {
+            Node* node = m_root;
+            while (!node->leaf)
+            {
+                auto inner = static_cast<Inner*>(node);
+                node = inner->children[lowerIndex(inner->keys, inner->count - 1, key)];
+            }
+            return static_cast<Leaf*>(node);
+        }
+
+        // NOTE : same as descendLB but for upper bound
+        template<class key_t>
+        Leaf* descendUB(const key_t& key)
+        {
+            Node* node = m_root;
+            while (!node->leaf)
+            {
+                auto inner = static_cast<Inner*>(node);
+                node = inner->children[upperIndex(inner->keys, inner->count - 1, key)];
+            }
+            return static_cast<Leaf*>(node);
+        }
+
+        // NOTE : position past the last key of the leaf is the first key of the next leaf
+        Iterator iter(Leaf* leaf, u32 index)
+        {
+            if (index == leaf->count)
+                return Iterator{this, leaf->next, 0};
+            return Iterator{this, leaf, index};
+        }
+
+        u32 childIndex(Inner* parent, Node* child)
+        {
+            u32 index = 0;
+            while (parent->children[index] != child)
+                ++index;
+            return index;
+        }
+
+
+    private: // insertion
+        // NOTE : right is inserted right after left into the parent of left, separator precedes all keys of right
+        void insertChild(Node* left, const Key& separator, Node* right)
+        {
+            Inner* parent = left->parent;
+            if (parent == nullptr)
+            {
+                parent = m_innerAllocator.alloc();
+                parent->children[0] = left;
+                parent->count = 1;
+
+                left->parent = parent;
+                m_root = parent;
+            }
+
+            u32 pos = childIndex(parent, left) + 1;
+            std::move_backward(parent->keys + pos - 1, parent->keys + parent->count - 1, parent->keys + parent->count);
+            std::move_backward(parent->children + pos, parent->children + parent->count, parent->children + parent->count + 1);
+            parent->keys[pos - 1] = separator;
+            parent->children[pos] = right;
+            right->parent = parent;
+            ++parent->count;
+
+            if (parent->count > fanout)
+                splitInner(parent);
+        }
+
+        // NOTE : returns new position of the key that was at index
+        Iterator splitLeaf(Leaf* leaf, u32 index)
+        {
+            Leaf* right = m_leafAllocator.alloc();
+            right->leaf = true;
+
+            u32 half = leaf->count / 2;
+            right->count = leaf->count - half;
+            std::move(leaf->keys + half, leaf->keys + leaf->count, right->keys);
+            leaf->count = half;
+
+            right->prev = leaf;
+            right->next = leaf->next;
+            if (leaf->next != nullptr)
+                leaf->next->prev = right;
+            else
+                m_last = right;
+            leaf->next = right;
+
+            insertChild(leaf, leaf->keys[half - 1], right);
+
+            if (index < half)
+                return Iterator{this, leaf, index};
+            return Iterator{this, right, index - half};
+        }
+
+        void splitInner(Inner* inner)
+        {
+            Inner* right = m_innerAllocator.alloc();
+
+            u32 half = inner->count / 2;
+            right->count = inner->count - half;
+            std::move(inner->children + half, inner->children + inner->count, right->children);
+            std::move(inner->keys + half, inner->keys + inner->count - 1, right->keys);
+            for (u32 i = 0; i < right->count; i++)
+                right->children[i]->parent = right;
+
+            Key separator = std::move(inner->keys[half - 1]);
+            inner->count = half;
+
+            insertChild(inner, separator, right);
+        }
+
+
+    private: // erasure
+        // NOTE : removes keys[index] and children[index + 1]
+        void removeChild(Inner* parent, u32 index)
+        {
+            std::move(parent->keys + index + 1, parent->keys + parent->count - 1, parent->keys + index);
+            std::move(parent->children + index + 2, parent->children + parent->count, parent->children + index + 1);
+            --parent->count;
+        }
+
+        void rebalanceLeaf(Leaf* leaf)
+        {
+            if (leaf == m_root)
+            {
+                if (leaf->count == 0)
+                {
+                    m_leafAllocator.dealloc(leaf);
+
+                    m_root  = nullptr;
+                    m_first = nullptr;
+                    m_last  = nullptr;
+                }
+                return;
+            }
+
+            if (leaf->count >= min_fill)
+                return;
+
+            Inner* parent = leaf->parent;
+            u32 pos = childIndex(parent, leaf);
+
+            Leaf* left  = pos > 0 ? static_cast<Leaf*>(parent->children[pos - 1]) : nullptr;
+            Leaf* right = pos + 1 < parent->count ? static_cast<Leaf*>(parent->children[pos + 1]) : nullptr;
+            if (left != nullptr && left->count > min_fill)
+            {
+                std::move_backward(leaf->keys, leaf->keys + leaf->count, leaf->keys + leaf->count + 1);
+                leaf->keys[0] = std::move(left->keys[left->count - 1]);
+                ++leaf->count;
+                --left->count;
+
+                parent->keys[pos - 1] = left->keys[left->count - 1];
+            }
+            else if (right != nullptr && right->count > min_fill)
+            {
+                leaf->keys[leaf->count] = std::move(right->keys[0]);
+                std::move(right->keys + 1, right->keys + right->count, right->keys);
+                ++leaf->count;
+                --right->count;
+
+                parent->keys[pos] = leaf->keys[leaf->count - 1];
+            }
+            else if (left != nullptr)
+            {
+                mergeLeaves(left, leaf, pos - 1);
+            }
+            else
+            {
+                mergeLeaves(leaf, right, pos);
+            }
+        }
+
+        // NOTE : right is merged into left, index is index of the separator between them
+        void mergeLeaves(Leaf* left, Leaf* right, u32 index)
+        {
+            std::move(right->keys, right->keys + right->count, left->keys + left->count);
+            left->count += right->count;
+
+            left->next = right->next;
+            if (right->next != nullptr)
+                right->next->prev = left;
+            else
+                m_last = left;
+
+            Inner* parent = left->parent;
+            removeChild(parent, index);
+            m_leafAllocator.dealloc(right);
+
+            rebalanceInner(parent);
+        }
+
+        void rebalanceInner(Inner* inner)
+        {
+            if (inner == m_root)
+            {
+                if (inner->count == 1)
+                {
+                    m_root = inner->children[0];
+                    m_root->parent = nullptr;
+                    m_innerAllocator.dealloc(inner);
+                }
+                return;
+            }
+
+            if (inner->count >= min_fill)
+                return;
+
+            Inner* parent = inner->parent;
+            u32 pos = childIndex(parent, inner);
+
+            Inner* left  = pos > 0 ? static_cast<Inner*>(parent->children[pos - 1]) : nullptr;
+            Inner* right = pos + 1 < parent->count ? static_cast<Inner*>(parent->children[pos + 1]) : nullptr;
+            if (left != nullptr && left->count > min_fill)
+            {
+                std::move_backward(inner->keys, inner->keys + inner->count - 1, inner->keys + inner->count);
+                std::move_backward(inner->children, inner->children + inner->count, inner->children + inner->count + 1);
+                inner->keys[0] = std::move(parent->keys[pos - 1]);
+                inner->children[0] = left->children[left->count - 1];
+                inner->children[0]->parent = inner;
+                ++inner->count;
+
+                parent->keys[pos - 1] = std::move(left->keys[left->count - 2]);
+                --left->count;
+            }
+            else if (right != nullptr && right->count > min_fill)
+            {
+                inner->keys[inner->count - 1] = std::move(parent->keys[pos]);
+                inner->children[inner->count] = right->children[0];
+                inner->children[inner->count]->parent = inner;
+                ++inner->count;
+
+                parent->keys[pos] = std::move(right->keys[0]);
+                std::move(right->keys + 1, right->keys + right->count - 1, right->keys);
+                std::move(right->children + 1, right->children + right->count, right->children);
+                --right->count;
+            }
+            else if (left != nullptr)
+            {
+                mergeInner(left, inner, pos - 1);
+            }
+            else
+            {
+                mergeInner(inner, right, pos);
+            }
+        }
+
+        void mergeInner(Inner* left, Inner* right, u32 index)
+        {
+            Inner* parent = left->parent;
+
+            left->keys[left->count - 1] = std::move(parent->keys[index]);
+            std::move(right->keys, right->keys + right->count - 1, left->keys + left->count);
+            std::move(right->children, right->children + right->count, left->children + left->count);
+            for (u32 i = 0; i < right->count; i++)
+                right->children[i]->parent = left;
+            left->count += right->count;
+
+            removeChild(parent, index);
+            m_innerAllocator.dealloc(right);
+
+            rebalanceInner(parent);
+        }
+
+        void clear(Node* node)
+        {
+            if (node->leaf)
+            {
+                m_leafAllocator.dealloc(static_cast<Leaf*>(node));
+            }
+            else
+            {
+                auto inner = static_cast<Inner*>(node);
+                for (u32 i = 0; i < inner->count; i++)
+                    clear(inner->children[i]);
+                m_innerAllocator.dealloc(inner);
+            }
+        }
+
+
+    public:
+        template<class key_t>
+        std::pair<Iterator, bool> insert(key_t&& key)
+        {
+            if (m_root == nullptr)
+            {
+                Leaf* leaf = m_leafAllocator.alloc();
+                leaf->leaf = true;
+
+                m_root  = leaf;
+                m_first = leaf;
+                m_last  = leaf;
+            }
+
+            Leaf* leaf{};
+            u32 index{};
+            if constexpr(tree_traits_t::multi)
+            {
+                leaf  = descendUB(key);
+                index = upperIndex(leaf->keys, leaf->count, key);
+            }
+            else
+            {
+                leaf  = descendLB(key);
+                index = lowerIndex(leaf->keys, leaf->count, key);
+
+                if (Iterator it = iter(leaf, index); it != end() && !m_compare(key, *it))
+                    return {it, false};
+            }
+
+            std::move_backward(leaf->keys + index, leaf->keys + leaf->count, leaf->keys + leaf->count + 1);
+            leaf->keys[index] = std::forward<key_t>(key);
+            ++leaf->count;
+            ++m_size;
+
+            if (leaf->count > fanout)
+                return {splitLeaf(leaf, index), true};
+            return {Iterator{this, leaf, index}, true};
+        }
+
+        // NOTE : erases only one of equal keys
+        template<class key_t>
+        void erase(key_t&& key)
+        {
+            if (Iterator it = find(std::forward<key_t>(key)); it != end())
+                erase(it);
+        }
+
+        void erase(Iterator it)
+        {
+            assert(it != end());
+
+            Leaf* leaf = it.m_leaf;
+            std::move(leaf->keys + it.m_index + 1, leaf->keys + leaf->count, leaf->keys + it.m_index);
+            --leaf->count;
+            --m_size;
+
+            leaf->keys[leaf->count] = Key{};
+
+            rebalanceLeaf(leaf);
+        }
+
+        template<class key_t>
+        bool contains(key_t&& key)
+        {
+            return find(std::forward<key_t>(key)) != end();
+        }
+
+        void clear()
+        {
+            if (m_root != nullptr)
+                clear(m_root);
+
+            m_root  = nullptr;
+            m_first = nullptr;
+            m_last  = nullptr;
+            m_size  = 0;
+        }
+
+        // NOTE : replaces content of the tree with keys from sorted range in O(n)
+        // range must be sorted according to Compare, for set-like trees keys must be unique
+        // nodes are filled as much as possible but not less than min_fill
+        template<class It>
+        void assignSorted(It first, It last)
+        {
+            clear();
+
+            auto count = (u32)std::distance(first, last);
+            if (count == 0)
+                return;
+
+            // NOTE : count of keys is distributed evenly among (count + fanout - 1) / fanout nodes
+            auto distribute = [] (u32 total, u32 nodes, u32 i)
+            {
+                return total / nodes + (i < total % nodes ? 1u : 0u);
+            };
+
+            std::vector<Node*> level;
+            std::vector<const Key*> maxKeys; // max key of each subtree of the level
+
+            u32 leaves = (count + fanout - 1) / fanout;
+            Leaf* prev = nullptr;
+            for (u32 i = 0; i < leaves; i++)
+            {
+                Leaf* leaf = m_leafAllocator.alloc();
+                leaf->leaf  = true;
+                leaf->count = distribute(count, leaves, i);
+                for (u32 j = 0; j < leaf->count; j++, ++first)
+                    leaf->keys[j] = *first;
+
+                leaf->prev = prev;
+                if (prev != nullptr)
+                    prev->next = leaf;
+                else
+                    m_first = leaf;
+                prev = leaf;
+
+                level.push_back(leaf);
+                maxKeys.push_back(&leaf->keys[leaf->count - 1]);
+            }
+            m_last = prev;
+            m_size = count;
+
+            while (level.size() > 1)
+            {
+                std::vector<Node*> upper;
+                std::vector<const Key*> upperMaxKeys;
+
+                u32 size  = (u32)level.size();
+                u32 nodes = (size + fanout - 1) / fanout;
+                for (u32 i = 0, child = 0; i < nodes; i++)
+                {
+                    Inner* inner = m_innerAllocator.alloc();
+                    inner->count = distribute(size, nodes, i);
+                    for (u32 j = 0; j < inner->count; j++, child++)
+                    {
+                        inner->children[j] = level[child];
+                        level[child]->parent = inner;
+                        if (j > 0)
+                            inner->keys[j - 1] = *maxKeys[child - 1];
+                    }
+
+                    upper.push_back(inner);
+                    upperMaxKeys.push_back(maxKeys[child - 1]);
+                }
+
+                level   = std::move(upper);
+                maxKeys = std::move(upperMaxKeys);
+            }
+            m_root = level[0];
+        }
+
+        bool empty() const
+        {
+            return m_root == nullptr;
+        }
+
+        u32 size() const
+        {
+            return m_size;
+        }
+
+
+        // NOTE : see trb::lookup_key
+        template<class key_t>
+        Iterator find(key_t&& key)
+        {
+            auto&& lookup = trb::lookup_key<Key, Compare>(std::forward<key_t>(key));
+
+            Iterator it = lowerBound(lookup);
+            if (it != end() && !m_compare(lookup, *it))
+                return it;
+            return end();
+        }
+
+        template<class key_t>
+        Iterator lowerBound(key_t&& key)
+        {
+            if (m_root == nullptr)
+                return end();
+
+            auto&& lookup = trb::lookup_key<Key, Compare>(std::forward<key_t>(key));
+
+            Leaf* leaf = descendLB(lookup);
+            return iter(leaf, lowerIndex(leaf->keys, leaf->count, lookup));
+        }
+
+        template<class key_t>
+        Iterator upperBound(key_t&& key)
+        {
+            if (m_root == nullptr)
+                return end();
+
+            auto&& lookup = trb::lookup_key<Key, Compare>(std::forward<key_t>(key));
+
+            Leaf* leaf = descendUB(lookup);
+            return iter(leaf, upperIndex(leaf->keys, leaf->count, lookup));
+        }
+
+        Iterator begin()
+        {
+            return Iterator{this, m_first, 0};
+        }
+
+        Iterator end()
+        {
+            return Iterator{this, nullptr, 0};
+        }
+
+
+    public: // debug
+        // NOTE : checks fill of the nodes, links, depth of leaves, order of keys and separators, O(n)
+        bool invariant()
+        {
+            if (m_root == nullptr)
+                return m_first == nullptr && m_last == nullptr && m_size == 0;
+            if (m_root->parent != nullptr)
+                return false;
+
+            u32 leafDepth = ~0u;
+            if (!invariant(m_root, 0, leafDepth, nullptr, nullptr))
+                return false;
+
+            u32 count = 0;
+            Leaf* prev = nullptr;
+            for (Leaf* leaf = m_first; leaf != nullptr; leaf = leaf->next)
+            {
+                if (leaf->prev != prev)
+                    return false;
+                for (u32 i = 0; i < leaf->count; i++, count++)
+                {
+                    const Key* key = &leaf->keys[i];
+                    const Key* prevKey = i > 0 ? &leaf->keys[i - 1] : (prev != nullptr ? &prev->keys[prev->count - 1] : nullptr);
+                    if (prevKey != nullptr && (tree_traits_t::multi ? m_compare(*key, *prevKey) : !m_compare(*prevKey, *key)))
+                        return false;
+                }
+                prev = leaf;
+            }
+            return prev == m_last && count == m_size;
+        }
+
+    private:
+        // NOTE : lower & upper are bounds from separators of ancestors (nullptr if there's none)
+        bool invariant(Node* node, u32 depth, u32& leafDepth, const Key* lower, const Key* upper)
+        {
+            if (node != m_root && (node->count < min_fill || node->count > fanout))
+                return false;
+
+            if (node->leaf)
+            {
+                if (leafDepth == ~0u)
+                    leafDepth = depth;
+                if (leafDepth != depth || node->count == 0)
+                    return false;
+
+                auto leaf = static_cast<Leaf*>(node);
+                for (u32 i = 0; i < leaf->count; i++)
+                {
+                    if (lower != nullptr && m_compare(leaf->keys[i], *lower))
+                        return false;
+                    if (upper != nullptr && m_compare(*upper, leaf->keys[i]))
+                        return false;
+                }
+                return true;
+            }
+
+            auto inner = static_cast<Inner*>(node);
+            if (inner->count < 2)
+                return false;
+            for (u32 i = 0; i < inner->count; i++)
+            {
+                if (inner->children[i]->parent != inner)
+                    return false;
+
+                const Key* childLower = i > 0 ? &inner->keys[i - 1] : lower;
+                const Key* childUpper = i + 1 < inner->count ? &inner->keys[i] : upper;
+                if (!invariant(inner->children[i], depth + 1, leafDepth, childLower, childUpper))
+                    return false;
+            }
+            return true;
+        }
+
+
+    private:
+        Node* m_root{nullptr};
+        Leaf* m_first{nullptr};
+        Leaf* m_last{nullptr};
+        u32 m_size{};
+
+        Compare m_compare{};
+        LeafAllocator m_leafAllocator{};
+        InnerAllocator m_innerAllocator{};
+    };
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "core.h"
+#include "pool_storage.h"
+
+#include <new>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+// node array addressed by 32-bit indices, every storage has its own index space
+// used by structures that store indices instead of pointers to save memory (see IndexLink in trb_node.h)
+//
+// array is split into chunks of power of two size so objects never move and index -> pointer is a shift and a mask,
+// chunks are aligned to chunk_bytes and the first slot of each chunk (header) keeps its number and the chunk table of the storage
+// so pointer -> index is O(1) and index is resolved from the address of any object of the same storage without the storage itself
+// index 0 (header of the first chunk) is reserved for nullptr
+//
+// alloc & dealloc are O(1) and not thread safe (same as PoolStorage), memory is returned to the system on destruction
+template<class T>
+class IndexedStorage
+{
+public:
+	union Entry;
+
+	struct Header
+	{
+		Entry** chunks; // chunk table, rewritten when the table grows
+		u32 chunk;
+	};
+
+	union Entry
+	{
+		u32 next;
+		Header header;
+		alignas(T) std::byte object[sizeof(T)];
+	};
+
+	static constexpr const u32 chunk_bytes = 1u << 16;
+
+	static_assert(sizeof(Entry) * 2 <= chunk_bytes, "Type is too big.");
+
+	static constexpr u32 log2(u32 value)
+	{
+		u32 result = 0;
+		while (value >>= 1)
+			++result;
+		return result;
+	}
+
+	static constexpr const u32 chunk_shift = log2(chunk_bytes / sizeof(Entry));
+	static constexpr const u32 chunk_size  = 1u << chunk_shift;
+	static constexpr const u32 chunk_mask  = chunk_size - 1;
+
+	// NOTE : indices must fit into 31 bit so that users can borrow the highest bit
+	static constexpr const u32 max_index  = (1u << 31) - 1;
+	static constexpr const u32 max_chunks = max_index / chunk_size + 1;
+
+
+public:
+	IndexedStorage() = default;
+
+	IndexedStorage(const IndexedStorage&) = delete;
+	IndexedStorage(IndexedStorage&& another) noexcept
+		: m_chunks{std::exchange(another.m_chunks, nullptr)}
+		, m_count{std::exchange(another.m_count, 0u)}
+		, m_capacity{std::exchange(another.m_capacity, 0u)}
+		, m_used{std::exchange(another.m_used, chunk_size)}
+		, m_head{std::exchange(another.m_head, 0u)}
+	{}
+
+	~IndexedStorage()
+	{
+		release();
+	}
+
+	IndexedStorage& operator = (const IndexedStorage&) = delete;
+	IndexedStorage& operator = (IndexedStorage&& another) noexcept
+	{
+		if (this != &another)
+		{
+			release();
+
+			m_chunks = std::exchange(another.m_chunks, nullptr);
+			m_count = std::exchange(another.m_count, 0u);
+			m_capacity = std::exchange(another.m_capacity, 0u);
+			m_used = std::exchange(another.m_used, chunk_size);
+			m_head = std::exchange(another.m_head, 0u);
+		}
+		return *this;
+	}
+
+private:
+	// NOTE : objects are not destructed, all of them must be already deallocated
+	void release()
+	{
+		for (u32 i = 0; i < m_count; i++)
+			::operator delete(m_chunks[i], std::align_val_t{chunk_bytes});
+		delete [] m_chunks;
+
+		m_chunks = nullptr;
+		m_count = 0;
+		m_capacity = 0;
+		m_used = chunk_size;
+		m_head = 0;
+	}
+
+
+public:
+	// NOTE : from is an address of any object of the storage (e.g. of the node that keeps the index)
+	static T* pointer(const void* from, u32 index)
+	{
+		if (index == 0)
+			return nullptr;
+		return reinterpret_cast<T*>(header(from)->chunks[index >> chunk_shift] + (index & chunk_mask));
+	}
+
+	static u32 index(const T* object)
+	{
+		if (object == nullptr)
+			return 0;
+
+		auto first = reinterpret_cast<const Entry*>(header(object));
+		auto entry = reinterpret_cast<const Entry*>(object);
+		return (first->header.chunk << chunk_shift) | (u32)(entry - first);
+	}
+
+	template<class ... Args>
+	T* alloc(Args&& ... args)
+	{
+		return pool_construct<T>(entry(next()), std::forward<Args>(args)...);
+	}
+
+	void dealloc(T* object)
+	{
+		u32 freed = index(object);
+
+		object->~T();
+
+		reinterpret_cast<Entry*>(object)->next = m_head;
+		m_head = freed;
+	}
+
+private:
+	static const Header* header(const void* ptr)
+	{
+		auto address = reinterpret_cast<std::uintptr_t>(ptr);
+		return reinterpret_cast<const Header*>(address & ~std::uintptr_t{chunk_bytes - 1});
+	}
+
+	u32 next()
+	{
+		if (u32 head = m_head; head != 0)
+		{
+			m_head = entry(head)->next;
+			return head;
+		}
+
+		if (m_used == chunk_size)
+		{
+			assert(m_count < max_chunks);
+
+			if (m_count == m_capacity)
+				grow();
+
+			auto chunk = static_cast<Entry*>(::operator new(chunk_size * sizeof(Entry), std::align_val_t{chunk_bytes}));
+			chunk->header = Header{m_chunks, m_count};
+
+			m_chunks[m_count++] = chunk;
+			m_used = 1; // first slot is the header
+		}
+		return ((m_count - 1) << chunk_shift) | m_used++;
+	}
+
+	// NOTE : O(chunks), headers of all chunks point to the new table
+	void grow()
+	{
+		u32 capacity = std::min(std::max(2 * m_capacity, 4u), max_chunks);
+
+		auto chunks = new Entry*[capacity]{};
+		std::copy(m_chunks, m_chunks + m_count, chunks);
+		delete [] m_chunks;
+
+		m_chunks = chunks;
+		m_capacity = capacity;
+		for (u32 i = 0; i < m_count; i++)
+			m_chunks[i]->header.chunks = m_chunks;
+	}
+
+	Entry* entry(u32 index) const
+	{
+		return m_chunks[index >> chunk_shift] + (index & chunk_mask);
+	}
+
+
+private:
+	Entry** m_chunks{nullptr};
+	u32 m_count{};
+	u32 m_capacity{};
+	u32 m_used{chunk_size}; // bump position in the last chunk
+	u32 m_head{};           // free list, 0 is the end of the list
+};
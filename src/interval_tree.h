@@ -0,0 +1,205 @@
+#pragma once
+
+#include "core.h"
+#include "primitive.h"
+#include "trb_tree.h"
+
+#include <limits>
+#include <vector>
+#include <cassert>
+#include <utility>
+#include <algorithm>
+
+// interval tree: red-black tree of closed intervals ordered by the low end,
+// every subtree keeps the maximum of the high ends (see trb::NodeSummary)
+// stabbing & overlap queries skip subtrees whose intervals all end before the query
+// and stop at nodes whose intervals all start after it
+//
+// NOTE : query visits the search path of the upper end of the query and the paths to the reported intervals,
+// so it is O(log n + k log(n / k)) for k reported intervals, not O(log n + k):
+// a subtree is entered if it has an interval that ends after the query low end even if that one is not reported
+namespace itree
+{
+	using Float = prim::Float;
+	using Line2 = prim::Line2;
+
+	// closed interval [low, high] of an object referenced by handle
+	template<class handle_t>
+	struct Interval
+	{
+		using Handle = handle_t;
+
+		Float low{};
+		Float high{};
+		Handle handle{};
+	};
+
+	// NOTE : transparent, intervals can be searched by the low end directly
+	template<class handle_t>
+	struct IntervalComparator
+	{
+		using is_transparent = void;
+		using Interval = itree::Interval<handle_t>;
+
+		bool operator () (const Interval& i0, const Interval& i1) const
+		{
+			return i0.low < i1.low;
+		}
+
+		bool operator () (const Interval& i0, Float low) const
+		{
+			return i0.low < low;
+		}
+
+		bool operator () (Float low, const Interval& i0) const
+		{
+			return low < i0.low;
+		}
+	};
+
+	template<class handle_t>
+	struct MaxHighAugment
+	{
+		using Summary = Float;
+
+		static Summary identity()
+		{
+			return -std::numeric_limits<Float>::infinity();
+		}
+
+		static Summary lift(const Interval<handle_t>& interval)
+		{
+			return interval.high;
+		}
+
+		static Summary combine(Summary left, Summary right)
+		{
+			return std::max(left, right);
+		}
+	};
+
+	template<class handle_t>
+	using interval_tree_traits_t = trb::TreeTraits<
+		Interval<handle_t>, IntervalComparator<handle_t>, trb::DefaultAllocator, false, true, false, MaxHighAugment<handle_t>
+	>;
+
+	template<class handle_t>
+	class IntervalTree : public trb::Tree<interval_tree_traits_t<handle_t>>
+	{
+	public:
+		using Tree     = trb::Tree<interval_tree_traits_t<handle_t>>;
+		using Node     = typename Tree::Node;
+		using Iterator = typename Tree::Iterator;
+		using Handle   = handle_t;
+		using Interval = itree::Interval<handle_t>;
+
+		IntervalTree() = default;
+
+		// NOTE : intervals can go in any order, tree is built in O(n log n)
+		explicit IntervalTree(std::vector<Interval> intervals)
+		{
+			std::sort(intervals.begin(), intervals.end(), IntervalComparator<handle_t>());
+
+			this->assignSorted(intervals.begin(), intervals.end());
+		}
+
+
+	private:
+		template<class Visitor>
+		void overlap(Node* node, Float low, Float high, Visitor& visitor)
+		{
+			while (node != this->m_nil && node->summary.value >= low)
+			{
+				overlap(node->left, low, high, visitor);
+
+				// node and its right subtree start after the query
+				if (node->key.low > high)
+					return;
+
+				if (node->key.high >= low)
+					visitor(node->key);
+
+				node = node->right;
+			}
+		}
+
+
+	public:
+		// NOTE : low <= high
+		Iterator insert(Float low, Float high, Handle handle)
+		{
+			assert(low <= high);
+
+			return Tree::insert(Interval{low, high, handle}).first;
+		}
+
+		using Tree::insert;
+
+		// NOTE : removes interval with the same ends & handle, returns false if there is no such interval
+		bool remove(const Interval& interval)
+		{
+			auto it = this->lowerBound(interval.low);
+			auto last = this->upperBound(interval.low);
+			for (; it != last; ++it)
+			{
+				if (it->high == interval.high && it->handle == interval.handle)
+				{
+					this->erase(it);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// NOTE : visits all intervals that contain x, O(log n + k log(n / k))
+		template<class Visitor>
+		void stab(Float x, Visitor visitor)
+		{
+			overlap(this->m_root, x, x, visitor);
+		}
+
+		// NOTE : visits all intervals that intersect [low, high], O(log n + k log(n / k))
+		template<class Visitor>
+		void overlap(Float low, Float high, Visitor visitor)
+		{
+			overlap(this->m_root, low, high, visitor);
+		}
+
+		// NOTE : maximum of the high ends, -inf if the tree is empty
+		Float maxHigh()
+		{
+			return this->summary();
+		}
+	};
+
+
+	// NOTE : y-extents of lines, handle is an index of the line so stabbing at y gives lines that cross horizontal line y
+	template<class handle_t = u32>
+	IntervalTree<handle_t> y_extents(const std::vector<Line2>& lines)
+	{
+		std::vector<Interval<handle_t>> intervals;
+		intervals.reserve(lines.size());
+		for (u32 i = 0; i < lines.size(); i++)
+		{
+			auto [low, high] = std::minmax(lines[i].v0.y, lines[i].v1.y);
+
+			intervals.push_back({low, high, (handle_t)i});
+		}
+		return IntervalTree<handle_t>(std::move(intervals));
+	}
+
+	// NOTE : x-extents of lines, handle is an index of the line so stabbing at x gives lines that cross vertical line x
+	template<class handle_t = u32>
+	IntervalTree<handle_t> x_extents(const std::vector<Line2>& lines)
+	{
+		std::vector<Interval<handle_t>> intervals;
+		intervals.reserve(lines.size());
+		for (u32 i = 0; i < lines.size(); i++)
+		{
+			auto [low, high] = std::minmax(lines[i].v0.x, lines[i].v1.x);
+
+			intervals.push_back({low, high, (handle_t)i});
+		}
+		return IntervalTree<handle_t>(std::move(intervals));
+	}
+}
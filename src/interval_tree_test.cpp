@@ -0,0 +1,128 @@
+#include "interval_tree_test.h"
+#include "interval_tree.h"
+
+#include <ctime>
+#include <random>
+#include <vector>
+#include <cassert>
+#include <iostream>
+#include <algorithm>
+
+namespace
+{
+	std::vector<prim::Line2> random_lines(u32 count, std::minstd_rand& gen)
+	{
+		std::uniform_real_distribution<prim::Float> coord(0.0, 1000.0);
+		std::uniform_real_distribution<prim::Float> length(0.0, 20.0);
+
+		std::vector<prim::Line2> lines(count);
+		for (auto& line : lines)
+		{
+			line.v0 = {coord(gen), coord(gen)};
+			line.v1 = line.v0 + prim::Vec2{length(gen) - 10.0, length(gen) - 10.0};
+		}
+		return lines;
+	}
+
+	std::vector<u32> brute_force(const std::vector<prim::Line2>& lines, prim::Float low, prim::Float high)
+	{
+		std::vector<u32> result;
+		for (u32 i = 0; i < lines.size(); i++)
+		{
+			auto [y0, y1] = std::minmax(lines[i].v0.y, lines[i].v1.y);
+			if (y0 <= high && low <= y1)
+				result.push_back(i);
+		}
+		return result;
+	}
+}
+
+void test_interval_tree()
+{
+	std::cout << "*******************************" << std::endl;
+	std::cout << "**** testing interval tree ****" << std::endl;
+	std::cout << "*******************************" << std::endl;
+
+	std::random_device device;
+	auto seed = device();
+	std::minstd_rand gen(seed);
+
+	std::cout << "seed: " << seed << std::endl;
+
+	std::uniform_real_distribution<prim::Float> coord(-10.0, 1010.0);
+	std::uniform_real_distribution<prim::Float> width(0.0, 30.0);
+
+	for (u32 count : {0u, 1u, 2u, 10u, 100u, 1000u})
+	{
+		auto lines = random_lines(count, gen);
+		auto tree = itree::y_extents(lines);
+		assert(tree.invariant());
+
+		for (u32 k = 0; k < 200; k++)
+		{
+			prim::Float low  = coord(gen);
+			prim::Float high = low + (k % 2 == 0 ? 0.0 : width(gen));
+
+			std::vector<u32> found;
+			if (low == high)
+				tree.stab(low, [&] (auto& interval) {found.push_back(interval.handle);});
+			else
+				tree.overlap(low, high, [&] (auto& interval) {found.push_back(interval.handle);});
+			std::sort(found.begin(), found.end());
+
+			assert(found == brute_force(lines, low, high));
+		}
+
+		// tree stays valid after removal of half of the intervals
+		for (u32 i = 0; i < lines.size(); i += 2)
+		{
+			auto [low, high] = std::minmax(lines[i].v0.y, lines[i].v1.y);
+			bool removed = tree.remove({low, high, i});
+			bool removedTwice = tree.remove({low, high, i});
+			assert(removed && !removedTwice);
+		}
+		assert(tree.invariant());
+
+		for (u32 k = 0; k < 200; k++)
+		{
+			prim::Float y = coord(gen);
+
+			std::vector<u32> found;
+			tree.stab(y, [&] (auto& interval) {found.push_back(interval.handle);});
+			std::sort(found.begin(), found.end());
+
+			auto expected = brute_force(lines, y, y);
+			expected.erase(std::remove_if(expected.begin(), expected.end(), [] (u32 i) {return i % 2 == 0;}), expected.end());
+			assert(found == expected);
+		}
+	}
+
+	// stabbing vs linear scan over segments
+	auto lines = random_lines(1'000'000, gen);
+	auto tree = itree::y_extents(lines);
+
+	std::vector<prim::Float> ys(1000);
+	for (auto& y : ys)
+		y = coord(gen);
+
+	u64 hits0 = 0;
+	auto c0 = clock();
+	for (auto y : ys)
+		tree.stab(y, [&] (auto&) {++hits0;});
+	c0 = clock() - c0;
+
+	u64 hits1 = 0;
+	auto c1 = clock();
+	for (auto y : ys)
+		for (auto& line : lines)
+			if (std::min(line.v0.y, line.v1.y) <= y && y <= std::max(line.v0.y, line.v1.y))
+				++hits1;
+	c1 = clock() - c1;
+
+	assert(hits0 == hits1);
+
+	std::cout << "stabbing elapsed: " << (f32)c0 / CLOCKS_PER_SEC << ", "
+		<< "linear scan elapsed: " << (f32)c1 / CLOCKS_PER_SEC << " (" << hits0 << ")" << std::endl;
+
+	std::cout << "testing ended" << std::endl << std::endl;
+}
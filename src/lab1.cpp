@@ -15,8 +15,11 @@
 
 #include "gfx-res.h"
 
+#include <span>
 #include <vector>
+#include <optional>
 #include <random>
+#include <ranges>
 #include <cassert>
 #include <iostream>
 
@@ -51,19 +54,31 @@ namespace
 			ptr[indices[i]] = value;
 	}
 
-	template<class Handle>
-	class DQuery
+	// colors points found by the tree query
+	template<class vec1, class vec2, class Handle>
+	struct Recolor
 	{
-	public:
-		using Query = std::vector<Handle>;
+		void operator() (Handle handle)
+		{
+			ptr[handle] = value;
+		}
 
-	public:
-		DQuery(u32 initCapacity)
+		void operator() (std::span<const Handle> range)
 		{
-			m_back.reserve(initCapacity);
-			m_front.reserve(initCapacity);
+			for (auto handle : range)
+				ptr[handle] = value;
 		}
 
+		vec1* ptr{};
+		vec2 value{};
+	};
+
+	// frames whose points are colored in the back & front color buffers, empty if no point is colored
+	class DQuery
+	{
+	public:
+		using Query = std::optional<AABB2>;
+
 	public:
 		void swap()
 		{
@@ -82,8 +97,8 @@ namespace
 
 		void clear()
 		{
-			m_back.clear();
-			m_front.clear();
+			m_back.reset();
+			m_front.reset();
 		}
 
 	private:
@@ -278,7 +293,7 @@ private: // init & deinit
 		auto [w, h] = m_window->framebufferSize();
 
 		m_points.reserve(max_points);
-		m_query.reset(new DQuery<Handle>(max_points));
+		m_query.reset(new DQuery());
 		m_tree.reset(new QuadTree({{0, 0}, {w, h}}, Sampler(this), NodeAllocator()));
 	}
 
@@ -473,10 +488,9 @@ private: // generation
 
 		// quadtree & query
 		m_query->clear();
-		m_tree->clear();
 
-		for (u32 i = 0; i < m_pointsGenerated; i++)
-			m_tree->insert(i);
+		auto handles = std::views::iota(0u, m_pointsGenerated);
+		m_tree->buildParallel(handles.begin(), handles.end());
 
 		m_frameChanged = true;
 	}
@@ -488,15 +502,19 @@ private: // query
 		m_gfxColors->waitSyncBack();
 
 		auto& query = m_query->back();
+		auto frame = frameToAABB();
 
-		// reset color
-		store_vec_value(m_gfxColors->backPtr(), m_color0, query.data(), (Handle)query.size());
-
-		// query points
-		m_tree->query(frameToAABB(), query);
-
-		// set new color
-		store_vec_value(m_gfxColors->backPtr(), m_color1, query.data(), (Handle)query.size());
+		// only points that left or entered the frame since back buffer was colored are recolored
+		if (query)
+		{
+			m_tree->forEachDelta(frame, *query, Recolor<GfxDBuffer4::vec, vec4, Handle>{m_gfxColors->backPtr(), m_color0});
+			m_tree->forEachDelta(*query, frame, Recolor<GfxDBuffer4::vec, vec4, Handle>{m_gfxColors->backPtr(), m_color1});
+		}
+		else
+		{
+			m_tree->forEachIn(frame, Recolor<GfxDBuffer4::vec, vec4, Handle>{m_gfxColors->backPtr(), m_color1});
+		}
+		query = frame;
 
 		m_gfxColors->flushBack();
 		m_gfxColors->syncBack();
@@ -628,7 +646,7 @@ private:
 
 	// points
 	std::vector<Vec2> m_points;
-	std::unique_ptr<DQuery<Handle>> m_query;
+	std::unique_ptr<DQuery> m_query;
 	std::unique_ptr<QuadTree>       m_tree;
 };
 
@@ -0,0 +1,304 @@
+#pragma once
+
+#include "core.h"
+#include "primitive.h"
+#include "quadtree.h"
+
+#include <limits>
+#include <vector>
+#include <thread>
+#include <cassert>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+
+// linear (pointerless) quadtree: elements are kept in an array sorted by Morton codes of their cells,
+// cell is a square of the 2^depth x 2^depth grid over the box, quadtree nodes are ranges of codes with common prefix
+// range query walks the codes from the lower-left to the upper-right cell of the query box
+// and jumps over runs of codes outside of it using BIGMIN (Tropf & Herzog, 1981)
+namespace qtree
+{
+	namespace
+	{
+		// NOTE : inserts zero bit before each of the lower 32 bits
+		u64 spread_bits(u64 value)
+		{
+			value &= 0x00000000FFFFFFFFull;
+			value = (value | (value << 16)) & 0x0000FFFF0000FFFFull;
+			value = (value | (value <<  8)) & 0x00FF00FF00FF00FFull;
+			value = (value | (value <<  4)) & 0x0F0F0F0F0F0F0F0Full;
+			value = (value | (value <<  2)) & 0x3333333333333333ull;
+			value = (value | (value <<  1)) & 0x5555555555555555ull;
+			return value;
+		}
+	}
+
+	// position_t is a functor mapping element_t to Vec2 (same as in QuadTree)
+	// code_t is an unsigned integer type of Morton codes, grid depth is at most half of its bits
+	//
+	// NOTE : intended for static sets: build is O(n), insert & remove are O(n) (array shift)
+	template<class element_t, class position_t, class code_t = u32>
+	class LinearQuadTree
+	{
+	public:
+		using Elem = element_t;
+		using Position = position_t;
+		using Code = code_t;
+
+		static_assert(std::is_unsigned_v<Code> && sizeof(Code) <= sizeof(u64));
+
+		static constexpr const u32 max_depth = 4 * sizeof(Code);
+		static constexpr const u32 default_depth = max_depth < 16 ? max_depth : 16;
+
+		struct Entry
+		{
+			Code code{};
+			Elem elem{};
+		};
+
+	private:
+		// bit 0 of each pair is x, bit 1 is y (same as Leaf)
+		static constexpr const Code x_mask = (Code)0x5555555555555555ull;
+		static constexpr const Code y_mask = (Code)0xAAAAAAAAAAAAAAAAull;
+
+
+	public:
+		explicit LinearQuadTree(const AABB& box, u32 depth = default_depth)
+		{
+			init(box, depth);
+		}
+
+		template<class PositionT>
+		LinearQuadTree(const AABB& box, PositionT&& position, u32 depth = default_depth)
+			noexcept(std::is_nothrow_constructible_v<Position, PositionT&&>)
+			: m_position(std::forward<PositionT>(position))
+		{
+			init(box, depth);
+		}
+
+	private:
+		void init(const AABB& box, u32 depth)
+		{
+			assert(0 < depth && depth <= max_depth);
+
+			m_box = box;
+			m_depth = depth;
+
+			Float cells = (Float)((u64)1 << depth);
+			m_scale = Vec2{cells / (box.v1.x - box.v0.x), cells / (box.v1.y - box.v0.y)};
+		}
+
+
+	private:
+		using Float = Vec2::value_type;
+
+		// NOTE : positions out of the box are clamped to the boundary cells
+		u32 cell(Float value, Float origin, Float scale) const
+		{
+			Float c = std::clamp((value - origin) * scale, Float(0), (Float)(((u64)1 << m_depth) - 1));
+			return (u32)c;
+		}
+
+		Code code(const Vec2& pos) const
+		{
+			u64 x = cell(pos.x, m_box.v0.x, m_scale.x);
+			u64 y = cell(pos.y, m_box.v0.y, m_scale.y);
+			return (Code)(spread_bits(x) | (spread_bits(y) << 1));
+		}
+
+		// NOTE : is cell of the code inside of the cell range [zmin, zmax], dilated coordinates keep order
+		static bool inRange(Code code, Code zmin, Code zmax)
+		{
+			Code x = code & x_mask;
+			Code y = code & y_mask;
+			return (zmin & x_mask) <= x && x <= (zmax & x_mask)
+				&& (zmin & y_mask) <= y && y <= (zmax & y_mask);
+		}
+
+		// NOTE : is cell of the code strictly inside of the cell range [zmin, zmax],
+		// cell order agrees with coordinate order so positions in such cells are inside of the box of the range
+		static bool inInterior(Code code, Code zmin, Code zmax)
+		{
+			Code x = code & x_mask;
+			Code y = code & y_mask;
+			return (zmin & x_mask) < x && x < (zmax & x_mask)
+				&& (zmin & y_mask) < y && y < (zmax & y_mask);
+		}
+
+		// NOTE : the smallest code greater than code inside of the cell range [zmin, zmax],
+		// code is outside of the range and zmin < code < zmax
+		Code bigMin(Code code, Code zmin, Code zmax) const
+		{
+			Code result = zmin;
+			for (u32 bit = 2 * m_depth; bit != 0; bit--)
+			{
+				Code mask = (Code)1 << (bit - 1);
+
+				// lower bits of the same coordinate as the current bit
+				Code lower = (mask - 1) & ((bit - 1) % 2 == 0 ? x_mask : y_mask);
+
+				u32 state = ((code & mask) ? 0b100 : 0) | ((zmin & mask) ? 0b010 : 0) | ((zmax & mask) ? 0b001 : 0);
+				switch (state)
+				{
+					case 0b000:
+					case 0b111:
+						break;
+
+					// range splits here: upper half is the candidate, search continues in the lower one
+					case 0b001:
+						result = (zmin | mask) & ~lower;
+						zmax = (zmax & ~mask) | lower;
+						break;
+
+					// range lies above the code
+					case 0b011:
+						return zmin;
+
+					// range lies below the code
+					case 0b100:
+						return result;
+
+					// search continues in the upper half
+					case 0b101:
+						zmin = (zmin | mask) & ~lower;
+						break;
+
+					default:
+						assert(false);
+						return result;
+				}
+			}
+			return result;
+		}
+
+		auto lowerBound(typename std::vector<Entry>::const_iterator first, Code code) const
+		{
+			return std::lower_bound(first, m_entries.end(), code, [] (const Entry& entry, Code code) {return entry.code < code;});
+		}
+
+		// NOTE : lower bound that expects code to be close to first: step doubles until it overshoots (galloping search),
+		// jumps of the query are mostly short so they stay within few cache lines
+		auto gallop(typename std::vector<Entry>::const_iterator first, Code code) const
+		{
+			auto less = [] (const Entry& entry, Code code) {return entry.code < code;};
+
+			u64 step = 1;
+			auto last = first;
+			while ((u64)(m_entries.end() - last) > step && less(last[step], code))
+			{
+				last += step;
+				step *= 2;
+			}
+			auto bound = (u64)(m_entries.end() - last) > step ? last + step + 1 : m_entries.end();
+			return std::lower_bound(last, bound, code, less);
+		}
+
+
+	public:
+		// NOTE : replaces content of the tree with elements of [first, last) (no duplicates), radix sort by codes
+		template<class It>
+		void build(It first, It last, u32 threads = std::thread::hardware_concurrency())
+		{
+			m_entries.clear();
+			m_entries.reserve(std::distance(first, last));
+			for (; first != last; ++first)
+				m_entries.push_back(Entry{code(m_position(*first)), *first});
+
+			std::vector<Entry> buffer;
+			radix_sort(m_entries, buffer, [] (const Entry& entry) {return (u64)entry.code;}, 2 * m_depth, threads);
+			m_entries.shrink_to_fit();
+		}
+
+		// NOTE : O(n), returns false if element is already present
+		bool insert(const Elem& elem)
+		{
+			Code c = code(m_position(elem));
+
+			auto it = lowerBound(m_entries.begin(), c);
+			for (; it != m_entries.end() && it->code == c; ++it)
+			{
+				if (it->elem == elem)
+					return false;
+			}
+			m_entries.insert(it, Entry{c, elem});
+			return true;
+		}
+
+		// NOTE : O(n), returns false if there is no such element
+		bool remove(const Elem& elem)
+		{
+			Code c = code(m_position(elem));
+
+			for (auto it = lowerBound(m_entries.begin(), c); it != m_entries.end() && it->code == c; ++it)
+			{
+				if (it->elem == elem)
+				{
+					m_entries.erase(it);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void clear()
+		{
+			m_entries.clear();
+		}
+
+		void query(const AABB& box, std::vector<Elem>& result) const
+		{
+			result.clear();
+			if (m_entries.empty() || !prim::overlaps(box, m_box))
+				return;
+
+			Code zmin = code(box.v0);
+			Code zmax = code(box.v1);
+
+			auto it = lowerBound(m_entries.begin(), zmin);
+			while (it != m_entries.end() && it->code <= zmax)
+			{
+				if (!inRange(it->code, zmin, zmax))
+				{
+					it = gallop(it, bigMin(it->code, zmin, zmax));
+					continue;
+				}
+
+				// only cells on the boundary of the query are partially covered
+				if (inInterior(it->code, zmin, zmax) || prim::inAABB(box, m_position(it->elem)))
+					result.push_back(it->elem);
+				++it;
+			}
+		}
+
+		u32 size() const
+		{
+			return (u32)m_entries.size();
+		}
+
+		bool empty() const
+		{
+			return m_entries.empty();
+		}
+
+		// NOTE : bytes of element storage
+		u64 memory() const
+		{
+			return (u64)m_entries.capacity() * sizeof(Entry);
+		}
+
+		const std::vector<Entry>& entries() const
+		{
+			return m_entries;
+		}
+
+
+	private:
+		Position m_position;
+
+		AABB m_box{};
+		Vec2 m_scale{};
+		u32 m_depth{};
+
+		std::vector<Entry> m_entries;
+	};
+}
@@ -5,95 +5,168 @@
 #include <new>
 #include <vector>
 #include <cassert>
-#include <cstdlib>
+#include <cstddef>
 #include <utility>
 #include <algorithm>
 #include <type_traits>
 
+// allocators in this file follow the same interface as trb::DefaultAllocator and qtree::Allocator
+// so they can be passed as allocator_t template parameter:
+// 1) T* alloc(Args&& ... args) - constructs an object from args and returns pointer to it
+// 2) void dealloc(T* object) - deconstructs an object under the pointer
+//
+// both operations are O(1): freed entries are kept in an intrusive free list,
+// fresh entries are handed out from the current chunk with a bump pointer
 
+
+// either link of the free list or storage for an object
 template<class T>
-class PoolStorageFixed
+union PoolEntry
 {
-private:
-	union Entry
-	{
-		T object;
-		Entry* next{nullptr};
-	};
+	PoolEntry* next;
+	alignas(T) std::byte object[sizeof(T)];
+};
+
+template<class T, class ... Args>
+T* pool_construct(void* memory, Args&& ... args)
+{
+	if constexpr(std::is_aggregate_v<T>)
+		return ::new(memory) T{std::forward<Args>(args)...};
+	else
+		return ::new(memory) T(std::forward<Args>(args)...);
+}
 
 
+// contiguous block of entries
+template<class T>
+class PoolChunk
+{
 public:
-	PollStorageFixed(u32 count) noexcept
-	{
-		m_objects = std::malloc(count * sizeof(Entry));
-		m_count = count;
+	using Entry = PoolEntry<T>;
 
-		init();
-	}
+public:
+	PoolChunk(u32 count)
+		: m_entries{static_cast<Entry*>(::operator new(count * sizeof(Entry), std::align_val_t{alignof(Entry)}))}
+		, m_count{count}
+	{}
 
-	PollStorageFixed(const PollStorageFixed&) = delete;
-	PollStorageFixed(PollStorageFixed&& another) noexcept
-		: m_objects{std::exchang(another.m_objects, nullptr)}
-		, m_head{std:exhange(another.m_head, nullptr)}
+	PoolChunk(const PoolChunk&) = delete;
+	PoolChunk(PoolChunk&& another) noexcept
+		: m_entries{std::exchange(another.m_entries, nullptr)}
 		, m_count{std::exchange(another.m_count, 0u)}
+		, m_used{std::exchange(another.m_used, 0u)}
 	{}
 
-	~PollStorageFixed() noexcept
+	~PoolChunk()
 	{
-		clear();
+		release();
 	}
 
-	PollStorageFixed& operator = (const PollStorageFixed&) = delete
-	PollStorageFixed& operator = (PollStorageFixed&& another) noexcept
+	PoolChunk& operator = (const PoolChunk&) = delete;
+	PoolChunk& operator = (PoolChunk&& another) noexcept
 	{
-		if (this == &another)
+		if (this != &another)
 		{
-			return *this;
+			release();
+
+			m_entries = std::exchange(another.m_entries, nullptr);
+			m_count = std::exchange(another.m_count, 0u);
+			m_used = std::exchange(another.m_used, 0u);
 		}
+		return *this;
+	}
+
+private:
+	void release()
+	{
+		if (m_entries != nullptr)
+			::operator delete(m_entries, std::align_val_t{alignof(Entry)});
+		m_entries = nullptr;
+	}
 
-		clear();
+public:
+	// returns nullptr if chunk is exhausted
+	Entry* bump()
+	{
+		if (m_used < m_count)
+			return m_entries + m_used++;
+		return nullptr;
+	}
 
-		m_objects = std::exchange(another.m_objects, nullptr);
-		m_head = std::exchange(another.m_head, nullptr);
-		m_count = std::exchange(another.m_count, 0u);
+	// NOTE : all entries are considered free after reset
+	void reset()
+	{
+		m_used = 0;
 	}
 
-private:
-	void init()
+	bool contains(const void* ptr) const
 	{
-		Entry* head = nullptr;
-		Entry* last = m_objects + m_count;
-		for (u32 i = 0; i < m_count; i++)
-		{
-			last -= 1;
-			last->next = head;
-			head = last;
-		}
-		m_head = head;
+		auto entry = static_cast<const Entry*>(ptr);
+		return m_entries != nullptr && m_entries <= entry && entry < m_entries + m_count;
 	}
 
-	void clear()
+	u32 available() const
 	{
-		std::free(m_objects);
+		return m_count - m_used;
 	}
 
+	u32 capacity() const
+	{
+		return m_count;
+	}
+
+
+private:
+	Entry* m_entries{nullptr};
+	u32 m_count{};
+	u32 m_used{};
+};
+
+
+// pool of fixed capacity
+template<class T>
+class PoolStorageFixed
+{
 public:
-	template<class ... Args>
-	T* alloc(Args&& ... args)
+	using Entry = PoolEntry<T>;
+
+public:
+	PoolStorageFixed(u32 count) : m_chunk(count)
+	{}
+
+	PoolStorageFixed(const PoolStorageFixed&) = delete;
+	PoolStorageFixed(PoolStorageFixed&& another) noexcept
+		: m_chunk{std::move(another.m_chunk)}
+		, m_head{std::exchange(another.m_head, nullptr)}
+	{}
+
+	~PoolStorageFixed() = default;
+
+	PoolStorageFixed& operator = (const PoolStorageFixed&) = delete;
+	PoolStorageFixed& operator = (PoolStorageFixed&& another) noexcept
 	{
-		assert(memory != nullptr);
-		
-		void* memory = m_head;
-		m_head = m_head->next;
-		
-		if constexpr(std::is_aggregate_v<T>)
+		if (this != &another)
 		{
-			return ::new(memory) T{std::forward<Args>(args)...};
+			m_chunk = std::move(another.m_chunk);
+			m_head = std::exchange(another.m_head, nullptr);
 		}
+		return *this;
+	}
+
+public:
+	// NOTE : canAlloc() must be true
+	template<class ... Args>
+	T* alloc(Args&& ... args)
+	{
+		Entry* entry = m_head;
+		if (entry != nullptr)
+			m_head = entry->next;
 		else
-		{
-			return ::new(memory) T(std::forward<Args>(args)...);
-		}
+			entry = m_chunk.bump();
+
+		assert(entry != nullptr);
+
+		return pool_construct<T>(entry, std::forward<Args>(args)...);
 	}
 
 	void dealloc(T* object)
@@ -102,42 +175,59 @@ public:
 
 		object->~T();
 
-		object->next = m_head;
-		m_head = object;
+		auto entry = reinterpret_cast<Entry*>(object);
+		entry->next = m_head;
+		m_head = entry;
+	}
+
+	// NOTE : objects are not destructed, all of them must be already deallocated or be trivially destructible
+	void reset()
+	{
+		m_head = nullptr;
+		m_chunk.reset();
 	}
 
 	bool contains(T* object) const
 	{
-		return m_objects != nullptr 
-			&& m_objects <= reinterpret_cast<Entry*>(object) && reinterpret_cast<Entry*>(object) < m_objects + m_count;
+		return m_chunk.contains(object);
 	}
 
 	bool canAlloc() const
 	{
-		return m_head != nullptr;
+		return m_head != nullptr || m_chunk.available() != 0;
 	}
 
 
 private:
-	Entry* m_objects{nullptr};
+	PoolChunk<T> m_chunk;
 	Entry* m_head{nullptr};
-	u32 m_count{};
 };
 
 
+// pool that grows by chunks, memory is returned to the system only on release() or destruction
 template<class T>
 class PoolStorage
 {
 public:
-	PoolStorage(u32 poolSize) : m_singlePoolSize(poolSize)
-	{}
+	using Entry = PoolEntry<T>;
 
-	PoolStorage(const PoolStorage&) = delete;
-	PoolStorage(PoolStorage&& another) noexcept : m_singlePoolSize{std::exchange(another.m_singlePoolSize, 0u)}
+	static constexpr const u32 default_chunk_size = 4096;
+
+public:
+	PoolStorage(u32 chunkSize = default_chunk_size) : m_chunkSize(chunkSize)
 	{
-		m_pools = std::move(another.m_polls);
+		assert(chunkSize != 0);
 	}
 
+	PoolStorage(const PoolStorage&) = delete;
+	PoolStorage(PoolStorage&& another) noexcept
+		: m_chunks{std::move(another.m_chunks)}
+		, m_head{std::exchange(another.m_head, nullptr)}
+		, m_current{std::exchange(another.m_current, 0u)}
+		, m_reserved{std::exchange(another.m_reserved, 0u)}
+		, m_chunkSize{another.m_chunkSize}
+	{}
+
 	~PoolStorage() = default;
 
 	PoolStorage& operator = (const PoolStorage&) = delete;
@@ -145,55 +235,142 @@ public:
 	{
 		if (this != &another)
 		{
-			return *this;
+			m_chunks = std::move(another.m_chunks);
+			m_head = std::exchange(another.m_head, nullptr);
+			m_current = std::exchange(another.m_current, 0u);
+			m_reserved = std::exchange(another.m_reserved, 0u);
+			m_chunkSize = another.m_chunkSize;
 		}
-
-		m_pools = std::move(another.m_pools);
-		m_singlePoolSize = std::exchange(another.m_singlePoolSize, 0u);
+		return *this;
 	}
 
+private:
+	Entry* next()
+	{
+		// reserved block goes ahead of the free list
+		if (m_reserved != 0)
+		{
+			--m_reserved;
+			return m_chunks[m_current].bump();
+		}
+
+		if (m_head != nullptr)
+			return std::exchange(m_head, m_head->next);
+
+		while (true)
+		{
+			if (m_current < m_chunks.size())
+			{
+				if (Entry* entry = m_chunks[m_current].bump(); entry != nullptr)
+					return entry;
+
+				// chunks after current one are left from previous reset
+				if (m_current + 1 < m_chunks.size())
+				{
+					++m_current;
+					continue;
+				}
+			}
+
+			m_chunks.emplace_back(m_chunkSize);
+			m_current = (u32)m_chunks.size() - 1;
+		}
+	}
 
 public:
 	template<class ... Args>
 	T* alloc(Args&& ... args)
 	{
-		auto pool = std::find_if(m_pools.begin(), m_pools.end(), [] (const auto& pool) {return pool->canAlloc();});
-		if (pool != m_pools.end())
-		{
-			m_pools.push_back(PoolStorage(m_singlePoolSize));
+		return pool_construct<T>(next(), std::forward<Args>(args)...);
+	}
+
+	void dealloc(T* object)
+	{
+		object->~T();
+
+		auto entry = reinterpret_cast<Entry*>(object);
+		entry->next = m_head;
+		m_head = entry;
+	}
+
+	// NOTE : next count allocations are placed in one contiguous block, even if the free list is not empty
+	void reserve(u32 count)
+	{
+		m_reserved = count;
+		if (m_current < m_chunks.size() && m_chunks[m_current].available() >= count)
+			return;
+
+		u32 insertPos = m_chunks.empty() ? 0u : m_current + 1;
+		m_chunks.emplace(m_chunks.begin() + insertPos, std::max(count, m_chunkSize));
+		m_current = insertPos;
+	}
+
+	// NOTE : takes chunks & free entries of another pool, objects allocated by another pool now belong to this one
+	// O(chunks + free entries of another), another becomes empty
+	void merge(PoolStorage&& another)
+	{
+		if (this == &another)
+			return;
 
-			return m_pools.back()->alloc(std::forward<Args>(args)...);
+		if (Entry* tail = another.m_head; tail != nullptr)
+		{
+			while (tail->next != nullptr)
+				tail = tail->next;
+			tail->next = m_head;
+			m_head = another.m_head;
 		}
-		return pool->alloc(sftd::forward<Args>(args)...);
+
+		// chunks go after current one so their unused entries are still handed out
+		for (auto& chunk : another.m_chunks)
+			m_chunks.push_back(std::move(chunk));
+
+		another.m_chunks.clear();
+		another.m_head = nullptr;
+		another.m_current = 0;
+		another.m_reserved = 0;
 	}
 
-	void dealloc(T* object)
+	// NOTE : objects are not destructed, all of them must be already deallocated or be trivially destructible
+	// chunks are kept and reused
+	void reset()
 	{
-		auto pool = findContaining(object);
-		
-		assert(pool != m_pools.end());
+		for (auto& chunk : m_chunks)
+			chunk.reset();
 
-		pool->dealloc(object);
+		m_head = nullptr;
+		m_current = 0;
+		m_reserved = 0;
 	}
 
-	bool contains(T* object) const
+	// NOTE : same as reset but memory is freed
+	void release()
 	{
-		return findContaining(object) != m_pools.end();
+		m_chunks.clear();
+
+		m_head = nullptr;
+		m_current = 0;
+		m_reserved = 0;
 	}
 
-	bool canAlloc() const
+	// NOTE : O(chunks), debug purposes only
+	bool contains(T* object) const
 	{
-		return true;
+		for (auto& chunk : m_chunks)
+			if (chunk.contains(object))
+				return true;
+		return false;
 	}
 
-private:
-	auto findContaining(T* object) const
+	bool canAlloc() const
 	{
-		return std::find_if(m_pools.begin(), m_pools.end(), [=] (const auto& pool) {return pool->contains(object);});
+		return true;
 	}
 
 
 private:
-	std::vector<PoolStorageFixed<T>> m_pools;
-	u32 m_singlePoolSize;
+	std::vector<PoolChunk<T>> m_chunks;
+	Entry* m_head{nullptr};
+	u32 m_current{};
+	u32 m_reserved{};
+	u32 m_chunkSize{default_chunk_size};
 };
@@ -0,0 +1,242 @@
+#include "pool_storage_test.h"
+#include "test_util.h"
+
+#include "core.h"
+#include "trb_set.h"
+#include "quadtree.h"
+#include "pool_storage.h"
+
+#include <set>
+#include <ctime>
+#include <vector>
+#include <random>
+#include <numeric>
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <algorithm>
+
+
+namespace
+{
+	struct Position
+	{
+		const qtree::Vec2& operator() (u32 handle) const
+		{
+			return (*points)[handle];
+		}
+
+		const std::vector<qtree::Vec2>* points{};
+	};
+
+	template<template<class> class allocator_t>
+	void bench_set(const char* name, const std::vector<u32>& keys)
+	{
+		ds::Set<u32, std::less<u32>, allocator_t> s;
+
+		auto c = clock();
+		for (auto& key : keys)
+			s.insert(key);
+		c = clock() - c;
+
+		std::cout << name << " set insert elapsed: " << (f32)c / CLOCKS_PER_SEC << std::endl;
+
+		c = clock();
+		for (auto& key : keys)
+			s.erase(key);
+		c = clock() - c;
+
+		std::cout << name << " set erase elapsed: " << (f32)c / CLOCKS_PER_SEC << std::endl;
+	}
+
+	template<template<class> class allocator_t>
+	void bench_quadtree(const char* name, const std::vector<qtree::Vec2>& points)
+	{
+		using Helper = qtree::Helper<u32, Position, allocator_t>;
+
+		typename Helper::Tree tree({{0.0, 0.0}, {1.0, 1.0}}, Position{&points}, typename Helper::NodeAllocator());
+
+		auto c = clock();
+		for (u32 i = 0; i < points.size(); i++)
+			tree.insert(i);
+		c = clock() - c;
+
+		std::cout << name << " quadtree insert elapsed: " << (f32)c / CLOCKS_PER_SEC << std::endl;
+
+		c = clock();
+		tree.clear();
+		c = clock() - c;
+
+		std::cout << name << " quadtree clear elapsed: " << (f32)c / CLOCKS_PER_SEC << std::endl;
+	}
+}
+
+
+void test_pool_storage()
+{
+	std::cout << "******************************" << std::endl;
+	std::cout << "**** testing pool storage ****" << std::endl;
+	std::cout << "******************************" << std::endl;
+
+	// fixed pool: exhaust, free, reuse
+	{
+		PoolStorageFixed<u64> pool(16);
+
+		std::vector<u64*> objects;
+		while (pool.canAlloc())
+			objects.push_back(pool.alloc(objects.size()));
+		assert(objects.size() == 16);
+
+		for (u32 i = 0; i < objects.size(); i++)
+			assert(pool.contains(objects[i]) && *objects[i] == i);
+
+		for (auto& object : objects)
+			pool.dealloc(object);
+		assert(pool.canAlloc());
+
+		pool.reset();
+		for (u32 i = 0; i < 16; i++)
+			pool.alloc(0u);
+		assert(!pool.canAlloc());
+	}
+
+	// growing pool: chunks, reserve, reset
+	{
+		PoolStorage<u64> pool(8);
+
+		std::vector<u64*> objects;
+		for (u32 i = 0; i < 100; i++)
+			objects.push_back(pool.alloc(i));
+		for (u32 i = 0; i < objects.size(); i++)
+			assert(pool.contains(objects[i]) && *objects[i] == i);
+
+		pool.reset();
+		pool.reserve(64);
+
+		u64* first = pool.alloc(0u);
+		for (u32 i = 1; i < 64; i++)
+		{
+			u64* object = pool.alloc(i);
+			assert(object == first + i);
+		}
+
+		pool.release();
+		assert(!pool.contains(first));
+	}
+
+	// merge: objects & free entries of another pool move over
+	{
+		PoolStorage<u64> pool(8);
+		PoolStorage<u64> another(8);
+
+		std::vector<u64*> objects;
+		for (u32 i = 0; i < 20; i++)
+			objects.push_back(another.alloc(i));
+		for (u32 i = 0; i < 10; i++)
+			another.dealloc(objects[i]);
+
+		pool.merge(std::move(another));
+		for (u32 i = 10; i < objects.size(); i++)
+			assert(pool.contains(objects[i]) && !another.contains(objects[i]));
+
+		// free entries are reused before new chunks are allocated
+		for (u32 i = 0; i < 10; i++)
+		{
+			u64* object = pool.alloc(i);
+			assert(std::find(objects.begin(), objects.begin() + 10, object) != objects.begin() + 10);
+		}
+		for (u32 i = 10; i < objects.size(); i++)
+			pool.dealloc(objects[i]);
+	}
+
+	// pool as a tree allocator
+	{
+		std::vector<u32> keys(10'000);
+		std::iota(keys.begin(), keys.end(), 0);
+
+		std::minstd_rand gen(12345);
+
+		for (u32 k = 0; k < 10; k++)
+		{
+			ds::ListSet<u32, std::less<u32>, PoolStorage> s;
+			std::set<u32> ref;
+
+			shuffle(keys, gen);
+			for (u32 i = 0; i < keys.size() / 2; i++)
+			{
+				s.insert(keys[i]);
+				ref.insert(keys[i]);
+			}
+
+			shuffle(keys, gen);
+			for (u32 i = 0; i < keys.size() / 2; i++)
+			{
+				s.erase(keys[i]);
+				ref.erase(keys[i]);
+			}
+
+			assert(s.invariant());
+			assert(std::equal(s.begin(), s.end(), ref.begin(), ref.end()));
+		}
+	}
+
+	// sorted rebuild of a non-empty pooled tree lands in one contiguous block
+	{
+		std::vector<u32> keys(10'000);
+		std::iota(keys.begin(), keys.end(), 0);
+
+		std::minstd_rand gen(12345);
+		shuffle(keys, gen);
+
+		ds::Set<u32, std::less<u32>, PoolStorage> s;
+		for (auto& key : keys)
+			s.insert(key);
+
+		// scatter the free list
+		for (u32 i = 0; i < keys.size(); i += 2)
+			s.erase(keys[i]);
+
+		std::sort(keys.begin(), keys.end());
+		s.assignSorted(keys.begin(), keys.end());
+		assert(s.invariant());
+		assert(std::equal(s.begin(), s.end(), keys.begin(), keys.end()));
+
+		std::vector<const u32*> addresses;
+		for (auto& key : s)
+			addresses.push_back(&key);
+		std::sort(addresses.begin(), addresses.end());
+
+		auto stride = (const std::byte*)addresses[1] - (const std::byte*)addresses[0];
+		for (u32 i = 1; i < addresses.size(); i++)
+			assert((const std::byte*)addresses[i] - (const std::byte*)addresses[i - 1] == stride);
+	}
+
+	std::cout << "testing ended" << std::endl << std::endl;
+}
+
+void test_pool_storage_bench()
+{
+	std::cout << "***********************************" << std::endl;
+	std::cout << "**** benchmarking pool storage ****" << std::endl;
+	std::cout << "***********************************" << std::endl;
+
+	std::minstd_rand gen(12345);
+
+	std::vector<u32> keys(2'000'000);
+	std::iota(keys.begin(), keys.end(), 0);
+	shuffle(keys, gen);
+
+	bench_set<trb::DefaultAllocator>("default", keys);
+	bench_set<PoolStorage>("pool", keys);
+
+	std::uniform_real_distribution<prim::Float> dist(0.0, 1.0);
+
+	std::vector<qtree::Vec2> points(1'000'000);
+	for (auto& point : points)
+		point = qtree::Vec2{dist(gen), dist(gen)};
+
+	bench_quadtree<qtree::Allocator>("default", points);
+	bench_quadtree<PoolStorage>("pool", points);
+
+	std::cout << std::endl;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+
+void test_pool_storage();
+
+void test_pool_storage_bench();
@@ -4,11 +4,17 @@
 #include "primitive.h"
 
 #include <memory>
+#include <span>
 #include <array>
 #include <queue>
+#include <atomic>
 #include <vector>
+#include <future>
+#include <thread>
 #include <cassert>
 #include <numeric>
+#include <functional>
+#include <iterator>
 #include <algorithm>
 #include <type_traits>
 
@@ -44,6 +50,81 @@ namespace qtree
 
 			return {v0, v0 + dv};
 		}
+
+		// NOTE : quadrant of the box that contains pos (points on the boundary go to the upper-right one)
+		// center is computed in the same way as boxes of the quadrants (see leaf_AABB)
+		Leaf quadrant(const AABB& aabb, const Vec2& pos)
+		{
+			auto center = aabb.v0 + (aabb.v1 - aabb.v0) * Vec2::value_type(0.5);
+
+			return (Leaf)((pos.x >= center.x ? 0b01 : 0b00) | (pos.y >= center.y ? 0b10 : 0b00));
+		}
+
+		// NOTE : runs task(0), ..., task(threads - 1) in parallel, task(0) runs on the calling thread
+		template<class Task>
+		void parallel_run(u32 threads, Task&& task)
+		{
+			std::vector<std::future<void>> tasks;
+			for (u32 i = 1; i < threads; i++)
+				tasks.push_back(std::async(std::launch::async, [&task, i] () {task(i);}));
+
+			task(0);
+			for (auto& t : tasks)
+				t.get();
+		}
+
+		// NOTE : stable LSD radix sort of items by the lowest bits of key(item) (u64), buffer is scratch space
+		// each pass counts digits of item chunks in parallel, then every chunk is scattered to its own offsets
+		template<class T, class Key>
+		void radix_sort(std::vector<T>& items, std::vector<T>& buffer, Key&& key, u32 bits, u32 threads)
+		{
+			constexpr const u32 digit_bits = 8;
+			constexpr const u32 digits = 1 << digit_bits;
+			constexpr const u32 min_chunk = 1 << 16;
+
+			u32 count = (u32)items.size();
+			threads = std::clamp(count / min_chunk, 1u, std::max(threads, 1u));
+
+			auto chunk = [&] (u32 i) {return std::pair{(u64)count * i / threads, (u64)count * (i + 1) / threads};};
+
+			buffer.resize(count);
+
+			std::vector<std::array<u32, digits>> offsets(threads);
+			for (u32 shift = 0; shift < bits; shift += digit_bits)
+			{
+				auto digit = [&] (const T& item) {return (u32)(key(item) >> shift) & (digits - 1);};
+
+				parallel_run(threads, [&] (u32 i)
+				{
+					auto [first, last] = chunk(i);
+
+					offsets[i].fill(0);
+					for (auto k = first; k < last; k++)
+						++offsets[i][digit(items[k])];
+				});
+
+				u32 offset = 0;
+				for (u32 d = 0; d < digits; d++)
+				{
+					for (u32 i = 0; i < threads; i++)
+					{
+						u32 size = offsets[i][d];
+						offsets[i][d] = offset;
+						offset += size;
+					}
+				}
+
+				parallel_run(threads, [&] (u32 i)
+				{
+					auto [first, last] = chunk(i);
+
+					for (auto k = first; k < last; k++)
+						buffer[offsets[i][digit(items[k])]++] = std::move(items[k]);
+				});
+
+				std::swap(items, buffer);
+			}
+		}
 	}
 
 	template<class T>
@@ -65,10 +146,20 @@ namespace qtree
 		}
 	};
 
-	template<class element_t>
+	// allocator that can take over objects of another one of the same type: void merge(Alloc&& another) (see PoolStorage)
+	template<class Alloc, class = void>
+	struct HasMerge : std::false_type
+	{};
+
+	template<class Alloc>
+	struct HasMerge<Alloc, std::void_t<decltype(std::declval<Alloc&>().merge(std::declval<Alloc&&>()))>> : std::true_type
+	{};
+
+	template<class element_t, class data_allocator_t = std::allocator<element_t>>
 	struct QuadNode
 	{
 		using Elem = element_t;
+		using Data = std::vector<element_t, data_allocator_t>;
 
 		bool empty() const
 		{
@@ -140,8 +231,11 @@ namespace qtree
 
 
 		AABB box{};
-		std::vector<Elem> data;
+		Data data;
 		std::array<QuadNode*, 4> children{nullptr};
+
+		// count of elements in the subtree, data.size() for a leaf
+		u32 count{};
 	};
 
 	// allocator_t has two methods:
@@ -149,30 +243,48 @@ namespace qtree
 	// 2) void dealloc(T* object) - deconstructs an object under the pointer
 	// 
 	// position_t is a functor mapping element_t to Vec2 (so you can store whatever you want here)
+	// data_allocator_t is a standard allocator template for element storage of leaves
 	// TODO : maybe I need to do deduction guides
-	template<class element_t, class position_t, template<class T> class allocator_t = Allocator>
+	template<class element_t, class position_t, template<class T> class allocator_t = Allocator,
+		template<class T> class data_allocator_t = std::allocator>
 	class QuadTree
 	{
 	public:
 		using Elem = element_t;
-		using Node = QuadNode<element_t>;
+		using Node = QuadNode<element_t, data_allocator_t<element_t>>;
 		using Position = position_t;
 		using NodeAllocator = allocator_t<Node>;
+		using DataAllocator = data_allocator_t<element_t>;
+
+		// NOTE : upper bound of the depth, traversal stacks have fixed size so tree operations don't allocate
+		static constexpr const u32 max_depth = 32;
+
+		static constexpr const u32 default_capacity = 32;
+		static constexpr const u32 default_depth = 16;
+
+	private:
+		// path from the root to a leaf (leaf excluded)
+		using PathStack = std::array<Node*, max_depth>;
+
+		// depth-first traversal: at most 3 pending siblings per level and 4 children of the deepest node
+		using TraversalStack = std::array<Node*, 3 * max_depth + 4>;
 
 
 	public:
-		explicit QuadTree(const AABB& box)
+		// NOTE : leaf splits when it would hold more than capacity elements (elements with the same position are never split),
+		// leaves of depth maxDepth are never split, maxDepth <= max_depth
+		explicit QuadTree(const AABB& box, u32 capacity = default_capacity, u32 maxDepth = default_depth)
 		{
-			allocRoot(box);
+			allocRoot(box, capacity, maxDepth);
 		}
 
 		template<class PositionT, class NodeAllocatorT>
-		QuadTree(const AABB& box, PositionT&& position, NodeAllocatorT&& alloc) 
+		QuadTree(const AABB& box, PositionT&& position, NodeAllocatorT&& alloc, u32 capacity = default_capacity, u32 maxDepth = default_depth)
 			noexcept(std::is_nothrow_constructible_v<Position, PositionT&&> && std::is_nothrow_constructible_v<NodeAllocator, NodeAllocatorT&&>)
 			: m_position(std::forward<PositionT>(position))
 			, m_allocator(std::forward<NodeAllocatorT>(alloc))
 		{
-			allocRoot(box);
+			allocRoot(box, capacity, maxDepth);
 		}
 
 		// for now
@@ -193,8 +305,15 @@ namespace qtree
 		QuadTree& operator = (QuadTree&&) noexcept = delete;
 
 	private:
-		void allocRoot(const AABB& box)
+		void allocRoot(const AABB& box, u32 capacity, u32 maxDepth)
 		{
+			assert(capacity > 0);
+			assert(maxDepth <= max_depth);
+
+			m_capacity = capacity;
+			m_lowWater = std::max(capacity / 2, 1u);
+			m_maxDepth = maxDepth;
+
 			m_root = m_allocator.alloc(box);
 		}
 
@@ -204,9 +323,37 @@ namespace qtree
 		}
 
 
-		bool contains(Node* node, const Elem& elem) const
+		// NOTE : node is not a leaf, child that contains pos (see quadrant)
+		static Node* child(Node* node, const Vec2& pos)
+		{
+			return node->children[(u32)quadrant(node->box, pos)];
+		}
+
+		// NOTE : squared distance between points
+		static Vec2::value_type distance2(const Vec2& v0, const Vec2& v1)
 		{
-			return prim::inAABB(node->box, m_position(elem));
+			auto d = v1 - v0;
+			return d.x * d.x + d.y * d.y;
+		}
+
+		// NOTE : squared distance from pos to the nearest point of the box, zero if pos is inside
+		static Vec2::value_type distance2(const AABB& aabb, const Vec2& pos)
+		{
+			using Float = Vec2::value_type;
+
+			Float dx = std::max({aabb.v0.x - pos.x, Float(0), pos.x - aabb.v1.x});
+			Float dy = std::max({aabb.v0.y - pos.y, Float(0), pos.y - aabb.v1.y});
+			return dx * dx + dy * dy;
+		}
+
+		// NOTE : squared distance from pos to the farthest corner of the box
+		static Vec2::value_type farthest2(const AABB& aabb, const Vec2& pos)
+		{
+			using Float = Vec2::value_type;
+
+			Float dx = std::max(pos.x - aabb.v0.x, aabb.v1.x - pos.x);
+			Float dy = std::max(pos.y - aabb.v0.y, aabb.v1.y - pos.y);
+			return dx * dx + dy * dy;
 		}
 
 		// NOTE : node is not empty, node != nullptr
@@ -222,51 +369,60 @@ namespace qtree
 				[&] (const auto& elem) {return m_position(elem) == m_position(node->data[0]);});
 		}
 
-		// NOTE : node is not empty, node != nullptr, all elements are same
+		// NOTE : node is a full leaf, elements are distributed among the children
+		// every child reserves capacity so that uniting children back never allocates
 		void subdivide(Node* node)
 		{
 			assert(node != nullptr);
-			assert(!node->empty() && allSame(node));
+			assert(node->leaf());
+
+			for (u32 i = 0; i < 4; i++)
+			{
+				node->children[i] = m_allocator.alloc(leaf_AABB((Leaf)i, node->box));
+				node->children[i]->data.reserve(m_capacity);
 
-			node->children[(u32)Leaf::SW] = m_allocator.alloc(leaf_AABB(Leaf::SW, node->box));
-			node->children[(u32)Leaf::SE] = m_allocator.alloc(leaf_AABB(Leaf::SE, node->box));
-			node->children[(u32)Leaf::NW] = m_allocator.alloc(leaf_AABB(Leaf::NW, node->box));
-			node->children[(u32)Leaf::NE] = m_allocator.alloc(leaf_AABB(Leaf::NE, node->box));
+				assert(node->children[i] != nullptr);
+			}
 
-			assert(node->children[(u32)Leaf::SW] != nullptr);
-			assert(node->children[(u32)Leaf::SE] != nullptr);
-			assert(node->children[(u32)Leaf::NW] != nullptr);
-			assert(node->children[(u32)Leaf::NE] != nullptr);
+			for (auto& elem : node->data)
+				child(node, m_position(elem))->data.push_back(std::move(elem));
+			typename Node::Data().swap(node->data);
 
 			for (auto& child : node->children)
-			{
-				if (contains(child, node->data[0]))
-				{
-					child->data = std::move(node->data);
-					break;
-				}
-			}
+				child->count = child->data.size();
+		}
+
+		// NOTE : node is not a leaf, all its children are leaves
+		// children are united if they hold no more than low-water mark elements (or only one of them
+		// is not empty and all its elements have the same position) so split & unite don't alternate
+		bool canUnite(Node* node) const
+		{
+			u32 count = 0;
+			for (auto& child : node->children)
+				count += child->data.size();
+			if (count <= m_lowWater)
+				return true;
+
+			return node->nonEmptyChildren() == 1 && allSame(*std::find_if(std::begin(node->children), std::end(node->children),
+				[] (auto child) {return !child->empty();}));
 		}
 
-		// NODE : node != nullptr, node is empty, node is not a leaf, node has only leaves 
-		// and count of non-empty children is less than or equal to 1
+		// NODE : node != nullptr, node is empty, node is not a leaf, node has only leaves, see canUnite
 		void unite(Node* node)
 		{
 			assert(node != nullptr);
 			assert(node->empty());
 			assert(!node->leaf());
 			assert(node->allLeaves());
-			assert(node->nonEmptyChildren() <= 1);
+			assert(canUnite(node));
 
-			for (auto& child : node->children)
-			{
-				while (!child->data.empty())
-				{
-					node->data.push_back(std::move(child->data.back()));
+			// the largest child gives its storage, the rest fit into it without reallocation
+			auto largest = *std::max_element(std::begin(node->children), std::end(node->children),
+				[] (auto c0, auto c1) {return c0->data.size() < c1->data.size();});
 
-					child->data.pop_back();
-				}
-			}
+			std::swap(node->data, largest->data);
+			for (auto& child : node->children)
+				node->data.insert(node->data.end(), std::make_move_iterator(child->data.begin()), std::make_move_iterator(child->data.end()));
 
 			m_allocator.dealloc(node->children[(u32)Leaf::SW]); node->children[(u32)Leaf::SW] = nullptr;
 			m_allocator.dealloc(node->children[(u32)Leaf::SE]); node->children[(u32)Leaf::SE] = nullptr;
@@ -278,160 +434,866 @@ namespace qtree
 	private:
 		bool insert(Node* node, const Elem& elem)
 		{
+			auto pos = m_position(elem);
+
+			PathStack stack;
 			u32 depth = 0;
-			while(depth < m_maxDepth)
+			while (!node->leaf())
 			{
-				if (node->leaf())
-				{
-					if (node->empty() || sameAs(node, elem))
-						// node->empty(), inserts element -> true
-						// node->same(), all elements in the node are the same, try to put
-						//		true if elements wasn't present in the node
-						//		false if was
-						return node->put(elem);
-					else
-						// never called if max_depth was reached
-						subdivide(node);
-				}
+				assert(depth < max_depth);
 
-				for (auto& child : node->children)
-				{
-					if (contains(child, elem))
-					{
-						node = child;
+				stack[depth++] = node;
+				node = child(node, pos);
+			}
 
-						break;
-					}
-				}
+			if (node->has(elem))
+				return false;
+
+			for (u32 i = 0; i < depth; i++)
+				++stack[i]->count;
+
+			put(node, depth, elem, pos);
+			return true;
+		}
+
+		// NOTE : node is a leaf of the given depth that doesn't have elem, pos is position of elem
+		void put(Node* node, u32 depth, const Elem& elem, const Vec2& pos)
+		{
+			// full leaf is split until element fits, splitting can't separate elements with the same position
+			while (node->data.size() >= m_capacity && depth < m_maxDepth && !(allSame(node) && sameAs(node, elem)))
+			{
+				subdivide(node);
+				++node->count;
 
+				node = child(node, pos);
 				++depth;
 			}
 
-			// max depth reached, node must be a leaf
-			assert(node != nullptr);
-			assert(node->leaf());
+			node->data.push_back(elem);
+			++node->count;
+		}
 
-			// element could've already been added -> false
-			// elemnts wasn't present in tree -> true
-			return node->put(elem);
+		// NOTE : stack is a path to a leaf that lost elements, nodes of the path are united bottom-up
+		// while they have only leaves and are sparse enough, nodes above stop are not touched
+		void uniteUp(const PathStack& stack, u32 size, u32 stop)
+		{
+			while (size > stop)
+			{
+				auto prev = stack[--size];
+				if (!prev->allLeaves() || !canUnite(prev))
+					break;
+
+				unite(prev);
+			}
 		}
 
 		bool remove(Node* node, const Elem& elem)
 		{
-			std::vector<Node*> stack;			
+			auto pos = m_position(elem);
+
+			PathStack stack;
+			u32 size = 0;
 			while (!node->leaf())
 			{
-				stack.push_back(node);
-				for (auto& child : node->children)
-				{
-					if (contains(child, elem))
-					{
-						node = child;
-						break;
-					}
-				}
+				assert(size < max_depth);
+
+				stack[size++] = node;
+				node = child(node, pos);
 			}
 
 			if (!node->rem(elem))
 				// no element was found
 				return false;
 
-			if (!node->empty() && !allSame(node))
-				// node is not empty and elements are not same we cannot unite any nodes
-				return true;
+			--node->count;
+			for (u32 i = 0; i < size; i++)
+				--stack[i]->count;
+
+			uniteUp(stack, size, 0);
+			return true;
+		}
 
-			// here we unite nodes
-			// node->empty() or node->allSame() so the following is possible:
-			// 1) node->empty() and node->allSame()
-			// 2) !node->empty() and node->allSame()
-			// 3) node->empty() and !node->allSame()
-			// 1 <=> 3, it doesn't matter if elements are same or not if there are no elements
-			while (!stack.empty())
+		bool update(Node* node, const Elem& elem, const Vec2& oldPos)
+		{
+			auto pos = m_position(elem);
+
+			PathStack stack;
+			u32 size = 0;
+			while (!node->leaf())
 			{
-				auto prev = stack.back();
-				stack.pop_back();
+				assert(size < max_depth);
 
-				if (!prev->allLeaves())
-					break;
+				stack[size++] = node;
+				node = child(node, oldPos);
+			}
+
+			if (!node->has(elem))
+				// no element was found
+				return false;
+
+			// lowest common ancestor: the deepest node of the path that contains both positions (stack[lca] or the leaf)
+			u32 lca = 0;
+			while (lca < size && child(stack[lca], pos) == (lca + 1 < size ? stack[lca + 1] : node))
+				++lca;
+			if (lca == size)
+				// same leaf
+				return true;
+
+			node->rem(elem);
+			--node->count;
+			for (u32 i = lca + 1; i < size; i++)
+				--stack[i]->count;
+
+			// count of the common ancestor doesn't change, the element goes down to another child
+			Node* target = child(stack[lca], pos);
+			u32 depth = lca + 1;
+			while (!target->leaf())
+			{
+				++target->count;
+				target = child(target, pos);
+				++depth;
+			}
+			put(target, depth, elem, pos);
 
-				if (prev->nonEmptyChildren() <= 1) // if all leaves are empty (so was node) or we ascend from all-same node
-					unite(prev);
-			}	
+			uniteUp(stack, size, lca + 1);
 			return true;
 		}
 
+		// NOTE : children are pushed in reverse order so they are popped in the order SW, SE, NW, NE
+		static void pushChildren(TraversalStack& stack, u32& size, Node* node)
+		{
+			assert(size + 4 <= stack.size());
+
+			for (u32 i = 4; i != 0; i--)
+				stack[size++] = node->children[i - 1];
+		}
+
 		void clear(Node* root)
 		{
 			// deallocates only children so root is untouched
-			if (root != nullptr)
+			// leaf children are nullptr and are never passed to the allocator
+			if (root == nullptr || root->leaf())
+				return;
+
+			TraversalStack stack;
+			u32 size = 0;
+
+			pushChildren(stack, size, root);
+			while (size != 0)
+			{
+				Node* node = stack[--size];
+				if (!node->leaf())
+					pushChildren(stack, size, node);
+
+				m_allocator.dealloc(node);
+			}
+		}
+
+		// NOTE : visitor(elem) may return bool, false stops traversal
+		template<class Visitor>
+		static bool visit(Visitor& visitor, const Elem& elem)
+		{
+			if constexpr(std::is_void_v<std::invoke_result_t<Visitor&, const Elem&>>)
 			{
-				for (auto& child : root->children)
+				visitor(elem);
+				return true;
+			}
+			else
+			{
+				return visitor(elem);
+			}
+		}
+
+		// NOTE : whole leaf goes to visitor at once if it accepts std::span<const Elem>
+		template<class Visitor>
+		static bool visitLeaf(Visitor& visitor, const Node* leaf)
+		{
+			if constexpr(std::is_invocable_v<Visitor&, std::span<const Elem>>)
+			{
+				if (leaf->empty())
+					return true;
+
+				std::span<const Elem> range(leaf->data);
+				if constexpr(std::is_void_v<std::invoke_result_t<Visitor&, std::span<const Elem>>>)
+				{
+					visitor(range);
+					return true;
+				}
+				else
+				{
+					return visitor(range);
+				}
+			}
+			else
+			{
+				for (auto& elem : leaf->data)
+				{
+					if (!visit(visitor, elem))
+						return false;
+				}
+				return true;
+			}
+		}
+
+		// NOTE : visits all elements of the subtree
+		template<class Visitor>
+		bool visitNode(Node* root, Visitor& visitor) const
+		{
+			TraversalStack stack;
+			u32 size = 0;
+
+			stack[size++] = root;
+			while (size != 0)
+			{
+				Node* node = stack[--size];
+				if (node->leaf())
 				{
-					clear(child);
+					if (!visitLeaf(visitor, node))
+						return false;
+				}
+				else
+				{
+					pushChildren(stack, size, node);
+				}
+			}
+			return true;
+		}
+
+		// NOTE : fully covered nodes are visited without tests, elements of partially covered leaves are tested one by one
+		template<class Visitor>
+		bool forEachIn(Node* root, const AABB& box, Visitor& visitor) const
+		{
+			TraversalStack stack;
+			u32 size = 0;
+
+			stack[size++] = root;
+			while (size != 0)
+			{
+				Node* node = stack[--size];
+				if (node->count == 0 || !prim::overlaps(box, node->box))
+					continue;
 
-					m_allocator.dealloc(child);
+				if (prim::inAABB(box, node->box))
+				{
+					if (!visitNode(node, visitor))
+						return false;
+					continue;
+				}
+				if (!node->leaf())
+				{
+					pushChildren(stack, size, node);
+				}
+				else
+				{
+					for (auto& elem : node->data)
+					{
+						if (prim::inAABB(box, m_position(elem)) && !visit(visitor, elem))
+							return false;
+					}
 				}
 			}
+			return true;
 		}
 
-		void query(Node* node, const AABB& box, std::vector<Elem>& result)
+		// appends visited elements to result
+		template<class Result>
+		struct Collector
 		{
-			if (!prim::overlaps(box, node->box))
-				return;
+			void operator () (const Elem& elem)
+			{
+				result.push_back(elem);
+			}
 
-			if (prim::inAABB(box, node->box))
+			void operator () (std::span<const Elem> range)
 			{
-				collectFromNode(node, result);
-				return;
+				result.insert(result.end(), range.begin(), range.end());
 			}
-			if (!node->leaf())
+
+			Result& result;
+		};
+
+		// writes visited elements to preallocated storage
+		struct Writer
+		{
+			void operator () (const Elem& elem)
 			{
-				for (auto& child : node->children)
-					query(child, box, result);
+				*out++ = elem;
 			}
-			else
+
+			void operator () (std::span<const Elem> range)
+			{
+				out = std::copy(range.begin(), range.end(), out);
+			}
+
+			Elem* out{};
+		};
+
+		// appends whole leaves to spans & single elements to partial
+		struct SpanCollector
+		{
+			void operator () (const Elem& elem)
+			{
+				partial.push_back(elem);
+			}
+
+			void operator () (std::span<const Elem> range)
 			{
-				for (auto& elem : node->data)
+				spans.push_back(range);
+			}
+
+			std::vector<std::span<const Elem>>& spans;
+			std::vector<Elem>& partial;
+		};
+
+		// NOTE : fully covered nodes are not descended, their subtree counts are taken
+		u32 count(Node* root, const AABB& box) const
+		{
+			TraversalStack stack;
+			u32 size = 0;
+
+			u32 result = 0;
+			stack[size++] = root;
+			while (size != 0)
+			{
+				Node* node = stack[--size];
+				if (node->count == 0 || !prim::overlaps(box, node->box))
+					continue;
+
+				if (prim::inAABB(box, node->box))
+				{
+					result += node->count;
+					continue;
+				}
+				if (!node->leaf())
 				{
-					if (prim::inAABB(box, m_position(elem)))
-						result.push_back(elem);
+					pushChildren(stack, size, node);
+				}
+				else
+				{
+					for (auto& elem : node->data)
+						result += prim::inAABB(box, m_position(elem));
 				}
 			}
+			return result;
 		}
 
-		void collectFromNode(Node* node, std::vector<Elem>& result)
+	private: // proximity search
+		using Float = Vec2::value_type;
+
+		// NOTE : element or node with squared distance to the searched point
+		template<class T>
+		struct Ranked
 		{
-			if (node->leaf())
+			Float dist2{};
+			T value{};
+
+			bool operator < (const Ranked& another) const
+			{
+				return dist2 < another.dist2;
+			}
+
+			bool operator > (const Ranked& another) const
+			{
+				return dist2 > another.dist2;
+			}
+		};
+
+		// NOTE : best is a max-heap of at most k elements, elem replaces the farthest one if it is closer
+		static void offer(std::vector<Ranked<Elem>>& best, u32 k, Float dist2, const Elem& elem)
+		{
+			if (best.size() < k)
+			{
+				best.push_back({dist2, elem});
+				std::push_heap(best.begin(), best.end());
+			}
+			else if (dist2 < best.front().dist2)
+			{
+				std::pop_heap(best.begin(), best.end());
+				best.back() = {dist2, elem};
+				std::push_heap(best.begin(), best.end());
+			}
+		}
+
+		// NOTE : best-first traversal: nodes are visited in order of distance from their boxes to pos,
+		// search stops when the nearest pending node is farther than the k-th best element
+		void nearest(Node* root, const Vec2& pos, u32 k, std::vector<Elem>& result) const
+		{
+			std::vector<Ranked<Elem>> best;
+			best.reserve(k);
+
+			std::vector<Ranked<Node*>> frontier;
+			frontier.push_back({distance2(root->box, pos), root});
+			while (!frontier.empty())
+			{
+				std::pop_heap(frontier.begin(), frontier.end(), std::greater<>());
+				auto [dist2, node] = frontier.back();
+				frontier.pop_back();
+
+				if (best.size() == k && dist2 >= best.front().dist2)
+					break;
+
+				if (node->leaf())
+				{
+					for (auto& elem : node->data)
+						offer(best, k, distance2(m_position(elem), pos), elem);
+					continue;
+				}
+				for (auto child : node->children)
+				{
+					Float childDist2 = distance2(child->box, pos);
+					if (best.size() < k || childDist2 < best.front().dist2)
+					{
+						frontier.push_back({childDist2, child});
+						std::push_heap(frontier.begin(), frontier.end(), std::greater<>());
+					}
+				}
+			}
+
+			std::sort_heap(best.begin(), best.end());
+			for (auto& ranked : best)
+				result.push_back(std::move(ranked.value));
+		}
+
+		void within(Node* root, const Vec2& pos, Float radius2, std::vector<Elem>& result) const
+		{
+			TraversalStack stack;
+			u32 size = 0;
+
+			stack[size++] = root;
+			while (size != 0)
+			{
+				Node* node = stack[--size];
+				if (distance2(node->box, pos) > radius2)
+					continue;
+
+				if (farthest2(node->box, pos) <= radius2)
+				{
+					Collector<std::vector<Elem>> collector{result};
+					visitNode(node, collector);
+					continue;
+				}
+				if (!node->leaf())
+				{
+					pushChildren(stack, size, node);
+				}
+				else
+				{
+					for (auto& elem : node->data)
+					{
+						if (distance2(m_position(elem), pos) <= radius2)
+							result.push_back(elem);
+					}
+				}
+			}
+		}
+
+
+	private: // bulk loading
+		struct Coded
+		{
+			u64 code{};
+			Elem elem{};
+		};
+
+		using CodedIt = typename std::vector<Coded>::iterator;
+
+		// NOTE : Morton code of the leaf of max depth that contains pos, 2 bits per level, the root level is the highest
+		// boxes are subdivided in the same way as nodes so code agrees with descent from the root
+		u64 mortonCode(const Vec2& pos) const
+		{
+			AABB box = m_root->box;
+
+			u64 code = 0;
+			for (u32 depth = 0; depth < m_maxDepth; depth++)
+			{
+				Leaf leaf = quadrant(box, pos);
+
+				code = (code << 2) | (u32)leaf;
+				box = leaf_AABB(leaf, box);
+			}
+			return code;
+		}
+
+		// NOTE : range is sorted by code
+		bool allSame(CodedIt first, CodedIt last) const
+		{
+			if (first->code != std::prev(last)->code)
+				return false;
+
+			return std::all_of(first, last, [&] (const Coded& coded) {return m_position(coded.elem) == m_position(first->elem);});
+		}
+
+		// NOTE : elements of [first, last) with their Morton codes, sorted by codes
+		template<class It>
+		std::vector<Coded> sortCoded(It first, It last, u32 threads) const
+		{
+			std::vector<Coded> items;
+			items.reserve(std::distance(first, last));
+			for (; first != last; ++first)
+				items.push_back(Coded{0, *first});
+
+			u32 count = (u32)items.size();
+			u32 tasks = std::clamp(count / (1u << 16), 1u, std::max(threads, 1u));
+			parallel_run(tasks, [&] (u32 i)
+			{
+				u32 k0 = (u64)count * i / tasks;
+				u32 k1 = (u64)count * (i + 1) / tasks;
+				for (u32 k = k0; k < k1; k++)
+					items[k].code = mortonCode(m_position(items[k].elem));
+			});
+
+			std::vector<Coded> buffer;
+			radix_sort(items, buffer, [] (const Coded& coded) {return coded.code;}, 2 * m_maxDepth, threads);
+			return items;
+		}
+
+		// NOTE : range is sorted by code, node is an empty leaf of the given depth, node gets count of the range
+		// same rules as in insert: leaf keeps at most capacity elements unless it has max depth or all positions are same
+		// returns false if node must be split
+		bool buildLeaf(Node* node, u32 depth, CodedIt first, CodedIt last) const
+		{
+			u32 count = (u32)(last - first);
+
+			node->count = count;
+			if (count <= m_capacity || depth == m_maxDepth || allSame(first, last))
+			{
+				node->data.reserve(std::max(count, m_capacity));
+				for (; first != last; ++first)
+					node->data.push_back(std::move(first->elem));
+				return true;
+			}
+			return false;
+		}
+
+		// NOTE : range is split between children of node, visitor(child, first, last) is called for every child
+		template<class Visitor>
+		void buildChildren(Node* node, u32 depth, CodedIt first, CodedIt last, NodeAllocator& allocator, Visitor&& visitor) const
+		{
+			u32 shift = 2 * (m_maxDepth - depth - 1);
+			for (u32 i = 0; i < 4; i++)
 			{
-				result.insert(result.end(), node->data.begin(), node->data.end());
+				auto next = std::partition_point(first, last, [&] (const Coded& coded) {return ((coded.code >> shift) & 0b11) <= i;});
+
+				node->children[i] = allocator.alloc(leaf_AABB((Leaf)i, node->box));
+				visitor(node->children[i], first, next);
+
+				first = next;
+			}
+		}
+
+		// NOTE : see buildLeaf
+		// children are allocated right before their subtrees are built so nodes go in depth-first order
+		void build(Node* node, u32 depth, CodedIt first, CodedIt last, NodeAllocator& allocator) const
+		{
+			if (buildLeaf(node, depth, first, last))
+				return;
+
+			buildChildren(node, depth, first, last, allocator, [&] (Node* child, CodedIt first, CodedIt last)
+			{
+				build(child, depth + 1, first, last, allocator);
+			});
+		}
+
+		// subtree that is built by one of the workers
+		struct Subtree
+		{
+			Node* node{};
+			u32 depth{};
+			CodedIt first{};
+			CodedIt last{};
+		};
+
+		// NOTE : builds levels above splitDepth, subtrees of splitDepth are left to workers
+		void buildTop(Node* node, u32 depth, CodedIt first, CodedIt last, u32 splitDepth, std::vector<Subtree>& subtrees)
+		{
+			if (depth == splitDepth)
+			{
+				subtrees.push_back({node, depth, first, last});
 				return;
 			}
-			for (auto& child : node->children)
-				collectFromNode(child, result);
+			if (buildLeaf(node, depth, first, last))
+				return;
+
+			buildChildren(node, depth, first, last, m_allocator, [&] (Node* child, CodedIt first, CodedIt last)
+			{
+				buildTop(child, depth + 1, first, last, splitDepth, subtrees);
+			});
 		}
 
+
 	public:
 		bool insert(const Elem& elem)
 		{
 			return insert(m_root, elem);
 		}
 
+		// NOTE : replaces content of the tree with elements of [first, last) (no duplicates),
+		// elements are sorted by Morton codes (radix sort, see radix_sort) and the tree is built top-down in one pass
+		// O(n) sort & O(n + nodes * log n) build
+		template<class It>
+		void build(It first, It last, u32 threads = std::thread::hardware_concurrency())
+		{
+			clear();
+
+			auto items = sortCoded(first, last, threads);
+			if (items.empty())
+				return;
+
+			build(m_root, 0, items.begin(), items.end(), m_allocator);
+		}
+
+		// NOTE : same as build but subtrees are built in parallel too: the top levels are built by the calling thread
+		// down to the depth that gives several subtrees per thread, then workers take subtrees, the largest first,
+		// each worker allocates nodes with its own allocator:
+		// 1) stateless allocator (e.g. Allocator) is copied, it must be thread safe
+		// 2) allocator with merge (e.g. PoolStorage) is default constructed, after the build the tree takes it over
+		template<class It>
+		void buildParallel(It first, It last, u32 threads = std::thread::hardware_concurrency())
+		{
+			static_assert(std::is_empty_v<NodeAllocator> || (HasMerge<NodeAllocator>::value && std::is_default_constructible_v<NodeAllocator>),
+				"buildParallel needs a stateless allocator or a default constructible one with merge (see PoolStorage).");
+
+			clear();
+
+			auto items = sortCoded(first, last, threads);
+			if (items.empty())
+				return;
+
+			threads = std::max(threads, 1u);
+
+			// 4^splitDepth >= 8 * threads
+			u32 splitDepth = 0;
+			while (splitDepth < m_maxDepth && ((u64)1 << 2 * splitDepth) < 8ull * threads)
+				++splitDepth;
+
+			std::vector<Subtree> subtrees;
+			buildTop(m_root, 0, items.begin(), items.end(), splitDepth, subtrees);
+
+			std::sort(subtrees.begin(), subtrees.end(), [] (const Subtree& s0, const Subtree& s1) {return s0.last - s0.first > s1.last - s1.first;});
+
+			u32 workers = std::min<u32>(threads, subtrees.size());
+
+			std::vector<NodeAllocator> allocators;
+			if constexpr(!std::is_empty_v<NodeAllocator>)
+				allocators.resize(workers);
+
+			std::atomic<u32> next{0};
+			parallel_run(workers, [&] (u32 worker)
+			{
+				auto work = [&] (NodeAllocator& allocator)
+				{
+					for (u32 i = next++; i < subtrees.size(); i = next++)
+					{
+						auto& subtree = subtrees[i];
+						build(subtree.node, subtree.depth, subtree.first, subtree.last, allocator);
+					}
+				};
+
+				if constexpr(std::is_empty_v<NodeAllocator>)
+				{
+					NodeAllocator allocator(m_allocator);
+					work(allocator);
+				}
+				else
+				{
+					work(allocators[worker]);
+				}
+			});
+
+			if constexpr(!std::is_empty_v<NodeAllocator>)
+			{
+				for (auto& allocator : allocators)
+					m_allocator.merge(std::move(allocator));
+			}
+		}
+
 		bool remove(const Elem& elem)
 		{
 			return remove(m_root, elem);
 		}
 
+		// NOTE : relocates element whose position has changed, oldPos is its position when it was inserted (or last updated)
+		// and the position functor gives the new one, the tree is not touched if element stays in the same leaf,
+		// otherwise element moves from its leaf up to the lowest common ancestor only and down to the new leaf
+		// returns false if there is no such element at oldPos
+		bool update(const Elem& elem, const Vec2& oldPos)
+		{
+			return update(m_root, elem, oldPos);
+		}
+
 		void clear()
 		{
 			clear(m_root);
 			for (auto& child : m_root->children)
 				child = nullptr;
+			m_root->data.clear();
+			m_root->count = 0;
+		}
+
+		// NOTE : result may use any allocator
+		template<class ResultAllocator>
+		void query(const AABB& box, std::vector<Elem, ResultAllocator>& result) const
+		{
+			result.clear();
+
+			Collector<std::vector<Elem, ResultAllocator>> collector{result};
+			forEachIn(m_root, box, collector);
+		}
+
+		// NOTE : result of query without copying: elements of fully covered leaves are reported as spans of leaf storage
+		// (valid until the tree is modified), the rest of elements are copied to partial
+		void query(const AABB& box, std::vector<std::span<const Elem>>& spans, std::vector<Elem>& partial) const
+		{
+			spans.clear();
+			partial.clear();
+
+			SpanCollector collector{spans, partial};
+			forEachIn(m_root, box, collector);
+		}
+
+		// NOTE : visits elements that are inside of the box to but not inside of the box from,
+		// only strips of to that stick out of from are queried so cost depends on the change, not on the size of the boxes
+		// visitor is the same as in forEachIn (elements only, spans are never passed), returns false if visitor stopped it
+		template<class Visitor>
+		bool forEachDelta(const AABB& from, const AABB& to, Visitor&& visitor) const
+		{
+			// strips don't intersect each other except their boundaries, element is visited in the first strip it is in
+			std::array<AABB, 4> strips;
+			u32 count = 0;
+			if (!prim::overlaps(from, to))
+			{
+				strips[count++] = to;
+			}
+			else
+			{
+				Float y0 = std::max(from.v0.y, to.v0.y);
+				Float y1 = std::min(from.v1.y, to.v1.y);
+				if (to.v0.y < from.v0.y)
+					strips[count++] = {to.v0, {to.v1.x, from.v0.y}};
+				if (to.v1.y > from.v1.y)
+					strips[count++] = {{to.v0.x, from.v1.y}, to.v1};
+				if (to.v0.x < from.v0.x)
+					strips[count++] = {{to.v0.x, y0}, {from.v0.x, y1}};
+				if (to.v1.x > from.v1.x)
+					strips[count++] = {{from.v1.x, y0}, {to.v1.x, y1}};
+			}
+
+			for (u32 i = 0; i < count; i++)
+			{
+				auto filter = [&] (const Elem& elem)
+				{
+					const auto& pos = m_position(elem);
+					if (prim::inAABB(from, pos) || !prim::inAABB(to, pos))
+						return true;
+					for (u32 j = 0; j < i; j++)
+						if (prim::inAABB(strips[j], pos))
+							return true;
+					return visit(visitor, elem);
+				};
+				if (!forEachIn(m_root, strips[i], filter))
+					return false;
+			}
+			return true;
+		}
+
+		// NOTE : moving query window: entered gets elements of to that are not in from, left gets elements of from that are not in to
+		void queryDelta(const AABB& from, const AABB& to, std::vector<Elem>& entered, std::vector<Elem>& left) const
+		{
+			entered.clear();
+			left.clear();
+
+			forEachDelta(from, to, [&] (const Elem& elem) {entered.push_back(elem);});
+			forEachDelta(to, from, [&] (const Elem& elem) {left.push_back(elem);});
+		}
+
+		// NOTE : results of boxes[i] are written to results[i] that is a span of elems (one flat buffer for all queries)
+		// boxes are processed in Morton order of their centers by several threads that take small chunks of them,
+		// each query is counted first (see count) so results are written in place without any allocation per query
+		// NOTE : tree must not be modified while batch is running
+		void queryBatch(std::span<const AABB> boxes, std::vector<Elem>& elems, std::vector<std::span<const Elem>>& results,
+			u32 threads = std::thread::hardware_concurrency()) const
+		{
+			constexpr const u32 chunk = 16;
+
+			u32 count = (u32)boxes.size();
+
+			std::vector<std::pair<u64, u32>> order(count);
+			for (u32 i = 0; i < count; i++)
+				order[i] = {mortonCode((boxes[i].v0 + boxes[i].v1) * Float(0.5)), i};
+			std::sort(order.begin(), order.end());
+
+			u32 tasks = std::clamp((count + chunk - 1) / chunk, 1u, std::max(threads, 1u));
+			auto run = [&] (auto&& query)
+			{
+				std::atomic<u32> next{0};
+				parallel_run(tasks, [&] (u32)
+				{
+					for (u32 first = next.fetch_add(chunk); first < count; first = next.fetch_add(chunk))
+					{
+						u32 last = std::min(first + chunk, count);
+						for (u32 k = first; k < last; k++)
+							query(order[k].second);
+					}
+				});
+			};
+
+			std::vector<u32> offsets(count + 1);
+			run([&] (u32 i) {offsets[i + 1] = this->count(m_root, boxes[i]);});
+			for (u32 i = 0; i < count; i++)
+				offsets[i + 1] += offsets[i];
+
+			elems.resize(offsets[count]);
+			results.resize(count);
+			run([&] (u32 i)
+			{
+				Writer writer{elems.data() + offsets[i]};
+				forEachIn(m_root, boxes[i], writer);
+
+				assert(writer.out == elems.data() + offsets[i + 1]);
+				results[i] = std::span<const Elem>(elems.data() + offsets[i], offsets[i + 1] - offsets[i]);
+			});
+		}
+
+		// NOTE : streams elements inside of the box to visitor as they are found, no result storage is needed
+		// visitor(const Elem&) may return bool: false stops the query, then forEachIn returns false
+		// if visitor also has operator () (std::span<const Elem>) elements of fully covered leaves are passed as whole spans
+		// NOTE : generic visitor (auto parameter) is called with spans too
+		template<class Visitor>
+		bool forEachIn(const AABB& box, Visitor&& visitor) const
+		{
+			return forEachIn(m_root, box, visitor);
+		}
+
+		// NOTE : count of elements inside of the box, same as size of query result
+		u32 count(const AABB& box) const
+		{
+			return count(m_root, box);
+		}
+
+		u32 size() const
+		{
+			return m_root->count;
+		}
+
+		bool empty() const
+		{
+			return m_root->count == 0;
 		}
 
-		void query(const AABB& box, std::vector<Elem>& result)
+		// NOTE : at most k elements nearest to pos sorted by distance (ties go in any order)
+		void nearest(const Vec2& pos, u32 k, std::vector<Elem>& result) const
 		{
 			result.clear();
-			query(m_root, box, result);
+			if (k != 0)
+				nearest(m_root, pos, k, result);
+		}
+
+		// NOTE : all elements at distance not greater than radius from pos, any order
+		void within(const Vec2& pos, Float radius, std::vector<Elem>& result) const
+		{
+			result.clear();
+			if (radius >= 0)
+				within(m_root, pos, radius * radius, result);
 		}
 		
 		#ifdef DEBUG_QTREE
@@ -441,8 +1303,72 @@ namespace qtree
 			u32 count = leafStat(m_root, 0u);
 			std::cout << "total elems: " << count << std::endl;
 		}
+
+		// NOTE : count of nodes
+		u32 nodes()
+		{
+			return nodes(m_root);
+		}
+
+		// NOTE : depth of the deepest leaf, root has zero depth
+		u32 depth()
+		{
+			return depth(m_root);
+		}
+
+		// NOTE : every node keeps count of elements in its subtree
+		bool countInvariant()
+		{
+			return countInvariant(m_root);
+		}
+
+		// NOTE : leaf that contains pos
+		const Node* leafOf(const Vec2& pos)
+		{
+			Node* node = m_root;
+			while (!node->leaf())
+				node = child(node, pos);
+			return node;
+		}
 		
 	private:
+		u32 nodes(Node* node)
+		{
+			u32 count = 1;
+			if (!node->leaf())
+			{
+				for (auto& child : node->children)
+					count += nodes(child);
+			}
+			return count;
+		}
+
+		bool countInvariant(Node* node)
+		{
+			if (node->leaf())
+				return node->count == node->data.size();
+
+			u32 count = 0;
+			for (auto& child : node->children)
+			{
+				if (!countInvariant(child))
+					return false;
+				count += child->count;
+			}
+			return node->empty() && node->count == count;
+		}
+
+		u32 depth(Node* node)
+		{
+			u32 result = 0;
+			if (!node->leaf())
+			{
+				for (auto& child : node->children)
+					result = std::max(result, depth(child) + 1);
+			}
+			return result;
+		}
+
 		u32 leafStat(Node* node, u32 depth)
 		{
 			u32 count = 0;
@@ -466,17 +1392,20 @@ namespace qtree
 		NodeAllocator m_allocator;
 
 		Node* m_root{nullptr};
-		u32 m_maxDepth{8};
+		u32 m_capacity{};
+		u32 m_lowWater{};
+		u32 m_maxDepth{};
 	};
 
 
 	// helper to access dependent types from QuadTree
-	template<class element_t, class position_t, template<class T> class allocator_t>
+	template<class element_t, class position_t, template<class T> class allocator_t, template<class T> class data_allocator_t = std::allocator>
 	struct Helper
 	{
-		using Tree = QuadTree<element_t, position_t, allocator_t>;
+		using Tree = QuadTree<element_t, position_t, allocator_t, data_allocator_t>;
 		using Elem = element_t;
 		using Position = position_t;
 		using NodeAllocator = allocator_t<typename Tree::Node>;
+		using DataAllocator = data_allocator_t<element_t>;
 	};
 }
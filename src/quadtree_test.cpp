@@ -2,8 +2,19 @@
 #include "test_util.h"
 
 #include "quadtree.h"
+#include "pool_storage.h"
+#include "linear_quadtree.h"
 
+#include <span>
+#include <ctime>
+#include <chrono>
+#include <thread>
 #include <random>
+#include <vector>
+#include <cassert>
+#include <numeric>
+#include <iostream>
+#include <algorithm>
 
 
 namespace
@@ -65,4 +76,1414 @@ void test_simple_quadtree()
 	{
 		qtr.remove(vec);
 	}
-}
\ No newline at end of file
+}
+
+namespace
+{
+	// handle is an index of a point as in Lab1
+	struct Sampler
+	{
+		const qtree::Vec2& operator() (u32 handle) const
+		{
+			return (*points)[handle];
+		}
+
+		const std::vector<qtree::Vec2>* points{};
+	};
+
+	// handles of count points: 0, 1, ..., count - 1
+	std::vector<u32> make_handles(u64 count)
+	{
+		std::vector<u32> handles(count);
+		std::iota(handles.begin(), handles.end(), 0);
+		return handles;
+	}
+
+	// same distribution as Lab1::generatePoints on 1920x1080 framebuffer
+	struct Lab1Points
+	{
+		using Vec2 = qtree::Vec2;
+		using Float = Vec2::value_type;
+
+		static constexpr const u32 count = 1'000'000;
+		static constexpr const Float w = 1920;
+		static constexpr const Float h = 1080;
+
+		Lab1Points(std::minstd_rand& gen)
+		{
+			points.reserve(count);
+			for (u32 i = 0; i < count; i++)
+				points.push_back(point(gen));
+			handles = make_handles(count);
+		}
+
+		// another point of the same distribution
+		Vec2 point(std::minstd_rand& gen)
+		{
+			Float x = genX(gen);
+			Float y = genY(gen);
+			return Vec2{x, y};
+		}
+
+		// frame of size (fraction of the framebuffer) at a random position inside of the framebuffer
+		qtree::AABB frame(std::minstd_rand& gen, Float size)
+		{
+			Vec2 p = point(gen);
+			Float x = p.x * (1 - size);
+			Float y = p.y * (1 - size);
+			return {{x, y}, {x + size * w, y + size * h}};
+		}
+
+		qtree::AABB box() const
+		{
+			return {{0, 0}, {w, h}};
+		}
+
+		std::uniform_real_distribution<Float> genX{0.02 * w, 0.98 * w};
+		std::uniform_real_distribution<Float> genY{0.02 * h, 0.98 * h};
+
+		std::vector<Vec2> points;
+		std::vector<u32> handles;
+	};
+
+	// random point of the box expanded by margin (fraction of its size) on each side,
+	// coordinates are on the 1000x1000 grid so that points often share them
+	qtree::Vec2 random_point(const qtree::AABB& box, qtree::Vec2::value_type margin, std::minstd_rand& gen)
+	{
+		auto w = box.v1.x - box.v0.x;
+		auto h = box.v1.y - box.v0.y;
+		auto x = box.v0.x - margin * w + (1 + 2 * margin) * w * (gen() % 1000) / 1000;
+		auto y = box.v0.y - margin * h + (1 + 2 * margin) * h * (gen() % 1000) / 1000;
+		return qtree::Vec2{x, y};
+	}
+
+	// box with corners at two random points (see random_point)
+	qtree::AABB random_box(const qtree::AABB& box, qtree::Vec2::value_type margin, std::minstd_rand& gen)
+	{
+		qtree::Vec2 p0 = random_point(box, margin, gen);
+		qtree::Vec2 p1 = random_point(box, margin, gen);
+		return {{std::min(p0.x, p1.x), std::min(p0.y, p1.y)}, {std::max(p0.x, p1.x), std::max(p0.y, p1.y)}};
+	}
+
+	// box of the coarse grid (see coarse_grid)
+	const qtree::AABB grid_box{{0, 0}, {100, 100}};
+
+	// points of grid_box on the 200x200 grid so that many of them have the same position
+	std::vector<qtree::Vec2> coarse_grid(u32 count, std::minstd_rand& gen)
+	{
+		using Float = qtree::Vec2::value_type;
+
+		std::vector<qtree::Vec2> grid;
+		grid.reserve(count);
+		for (u32 i = 0; i < count; i++)
+			grid.push_back(qtree::Vec2{(Float)(gen() % 200) * Float(0.5), (Float)(gen() % 200) * Float(0.5)});
+		return grid;
+	}
+
+	// NOTE : count of allocations made by counting allocators below
+	u64 allocations = 0;
+
+	// node allocator (see qtree::Allocator) that counts allocations
+	template<class T>
+	class CountingAllocator
+	{
+	public:
+		template<class ... Args>
+		T* alloc(Args&& ... args)
+		{
+			++allocations;
+			return qtree::Allocator<T>().alloc(std::forward<Args>(args)...);
+		}
+
+		void dealloc(T* ptr)
+		{
+			qtree::Allocator<T>().dealloc(ptr);
+		}
+	};
+
+	// standard allocator for leaf & result storage that counts allocations
+	template<class T>
+	struct CountingStdAllocator
+	{
+		using value_type = T;
+
+		CountingStdAllocator() = default;
+
+		template<class U>
+		CountingStdAllocator(const CountingStdAllocator<U>&) noexcept
+		{}
+
+		T* allocate(std::size_t count)
+		{
+			++allocations;
+			return std::allocator<T>().allocate(count);
+		}
+
+		void deallocate(T* ptr, std::size_t count) noexcept
+		{
+			std::allocator<T>().deallocate(ptr, count);
+		}
+
+		template<class U>
+		bool operator == (const CountingStdAllocator<U>&) const noexcept
+		{
+			return true;
+		}
+	};
+
+	// NOTE : runs op count times and returns allocations per call
+	template<class Op>
+	f64 count_allocations(u32 count, Op op)
+	{
+		allocations = 0;
+		for (u32 i = 0; i < count; i++)
+			op(i);
+
+		return (f64)allocations / count;
+	}
+}
+
+void test_quadtree_allocations()
+{
+	std::cout << "**************************************" << std::endl;
+	std::cout << "**** testing quadtree allocations ****" << std::endl;
+	std::cout << "**************************************" << std::endl;
+
+	using Vec2 = qtree::Vec2;
+	using Helper = qtree::Helper<u32, Sampler, CountingAllocator, CountingStdAllocator>;
+
+	std::random_device device;
+	auto seed = device();
+	std::minstd_rand gen(seed);
+
+	std::cout << "seed: " << seed << std::endl;
+
+	Lab1Points lab1(gen);
+	const auto& points = lab1.points;
+	const u32 count = lab1.count;
+
+	Helper::Tree tree(lab1.box(), Sampler{&points}, Helper::NodeAllocator());
+
+	auto c = clock();
+	f64 inserted = count_allocations(count, [&] (u32 i) {tree.insert(i);});
+	c = clock() - c;
+	std::cout << "insert allocations per call: " << inserted << ", elapsed: " << (f32)c / CLOCKS_PER_SEC << std::endl;
+
+	// random frames, result capacity is reserved as Lab1 does
+	std::vector<qtree::AABB> frames;
+	for (u32 i = 0; i < 1000; i++)
+		frames.push_back(random_box(lab1.box(), 0, gen));
+
+	std::vector<u32, CountingStdAllocator<u32>> result;
+	result.reserve(count);
+
+	c = clock();
+	f64 queried = count_allocations(frames.size(), [&] (u32 i) {tree.query(frames[i], result);});
+	c = clock() - c;
+	std::cout << "query allocations per call: " << queried << ", elapsed: " << (f32)c / CLOCKS_PER_SEC << std::endl;
+	assert(queried == 0.0);
+
+	for (u32 i = 0; i < 10; i++)
+	{
+		tree.query(frames[i], result);
+
+		u32 expected = std::count_if(points.begin(), points.end(), [&] (const Vec2& point) {return prim::inAABB(frames[i], point);});
+		assert(result.size() == expected);
+	}
+
+	auto& handles = lab1.handles;
+	shuffle(handles, gen);
+
+	c = clock();
+	f64 removed = count_allocations(count, [&] (u32 i) {tree.remove(handles[i]);});
+	c = clock() - c;
+	std::cout << "remove allocations per call: " << removed << ", elapsed: " << (f32)c / CLOCKS_PER_SEC << std::endl;
+	assert(removed == 0.0);
+
+	tree.query(lab1.box(), result);
+	assert(result.empty());
+
+	std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+namespace
+{
+	template<class Tree>
+	void test_buckets_random(std::minstd_rand& gen, u32 capacity, u32 depth)
+	{
+		using Vec2 = qtree::Vec2;
+
+		std::vector<Vec2> points = coarse_grid(20000, gen);
+
+		Tree tree(grid_box, Sampler{&points}, qtree::Allocator<typename Tree::Node>(), capacity, depth);
+
+		std::vector<bool> present(points.size());
+		for (u32 i = 0; i < 100000; i++)
+		{
+			u32 handle = gen() % points.size();
+			if (gen() % 3 != 0)
+			{
+				bool inserted = tree.insert(handle);
+				assert(inserted == !present[handle]);
+				present[handle] = true;
+			}
+			else
+			{
+				bool removed = tree.remove(handle);
+				assert(removed == present[handle]);
+				present[handle] = false;
+			}
+		}
+		assert(tree.depth() <= depth);
+
+		std::vector<u32> result;
+		for (u32 i = 0; i < 100; i++)
+		{
+			qtree::AABB box = random_box(grid_box, 0, gen);
+			tree.query(box, result);
+
+			std::vector<u32> expected;
+			for (u32 handle = 0; handle < points.size(); handle++)
+				if (present[handle] && prim::inAABB(box, points[handle]))
+					expected.push_back(handle);
+
+			std::sort(result.begin(), result.end());
+			assert(result == expected);
+		}
+
+		// everything removed, all nodes are united back
+		for (u32 handle = 0; handle < points.size(); handle++)
+			if (present[handle])
+				tree.remove(handle);
+		assert(tree.nodes() == 1);
+	}
+}
+
+void test_quadtree_buckets()
+{
+	std::cout << "**********************************" << std::endl;
+	std::cout << "**** testing quadtree buckets ****" << std::endl;
+	std::cout << "**********************************" << std::endl;
+
+	using Tree = qtree::Helper<u32, Sampler, qtree::Allocator>::Tree;
+
+	std::random_device device;
+	auto seed = device();
+	std::minstd_rand gen(seed);
+
+	std::cout << "seed: " << seed << std::endl;
+
+	test_buckets_random<Tree>(gen, 1, 8);
+	test_buckets_random<Tree>(gen, 4, 12);
+	test_buckets_random<Tree>(gen, 16, 16);
+	test_buckets_random<Tree>(gen, 64, 4);
+
+	// node count & query time on Lab1-like dataset
+	Lab1Points lab1(gen);
+
+	std::vector<qtree::AABB> frames;
+	for (u32 i = 0; i < 1000; i++)
+		frames.push_back(lab1.frame(gen, 0.1));
+
+	std::vector<u32> result;
+	result.reserve(lab1.count);
+	for (auto [capacity, depth] : {std::pair{1u, 8u}, std::pair{1u, 16u}, std::pair{8u, 16u}, std::pair{32u, 16u}, std::pair{128u, 16u}})
+	{
+		Tree tree(lab1.box(), Sampler{&lab1.points}, qtree::Allocator<Tree::Node>(), capacity, depth);
+
+		auto c0 = clock();
+		for (auto handle : lab1.handles)
+			tree.insert(handle);
+		c0 = clock() - c0;
+
+		u64 found = 0;
+		auto c1 = clock();
+		for (auto& frame : frames)
+		{
+			tree.query(frame, result);
+			found += result.size();
+		}
+		c1 = clock() - c1;
+
+		std::cout << "capacity: " << capacity << ", depth: " << depth << ", nodes: " << tree.nodes() << ", tree depth: " << tree.depth()
+			<< ", insert elapsed: " << (f32)c0 / CLOCKS_PER_SEC << ", query elapsed: " << (f32)c1 / CLOCKS_PER_SEC << " (" << found << ")" << std::endl;
+	}
+
+	std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+namespace
+{
+	// NOTE : tree built from points must have the same shape & content as the tree with points inserted one by one
+	template<class Tree>
+	void test_build_same(const std::vector<qtree::Vec2>& points, const qtree::AABB& box, u32 capacity, u32 depth, u32 threads, std::minstd_rand& gen)
+	{
+		std::vector<u32> handles = make_handles(points.size());
+
+		Tree inserted(box, Sampler{&points}, qtree::Allocator<typename Tree::Node>(), capacity, depth);
+		for (auto handle : handles)
+			inserted.insert(handle);
+
+		Tree built(box, Sampler{&points}, qtree::Allocator<typename Tree::Node>(), capacity, depth);
+		built.build(handles.begin(), handles.end(), threads);
+
+		assert(built.nodes() == inserted.nodes());
+		assert(built.depth() == inserted.depth());
+
+		std::vector<u32> r0;
+		std::vector<u32> r1;
+		for (u32 i = 0; i < 20; i++)
+		{
+			qtree::AABB frame = random_box(box, 0, gen);
+			inserted.query(frame, r0);
+			built.query(frame, r1);
+
+			std::sort(r0.begin(), r0.end());
+			std::sort(r1.begin(), r1.end());
+			assert(r0 == r1);
+		}
+
+		// built tree stays valid for updates
+		shuffle(handles, gen);
+		for (auto handle : handles)
+		{
+			bool removed = built.remove(handle);
+			assert(removed);
+		}
+		assert(built.nodes() == 1);
+	}
+}
+
+void test_quadtree_build()
+{
+	std::cout << "********************************" << std::endl;
+	std::cout << "**** testing quadtree build ****" << std::endl;
+	std::cout << "********************************" << std::endl;
+
+	using Vec2 = qtree::Vec2;
+	using Float = Vec2::value_type;
+	using Tree = qtree::Helper<u32, Sampler, qtree::Allocator>::Tree;
+
+	std::random_device device;
+	auto seed = device();
+	std::minstd_rand gen(seed);
+
+	std::cout << "seed: " << seed << std::endl;
+
+	std::vector<Vec2> grid = coarse_grid(20000, gen);
+
+	for (u32 threads : {1, 4})
+	{
+		test_build_same<Tree>(grid, grid_box, 1, 8, threads, gen);
+		test_build_same<Tree>(grid, grid_box, 4, 12, threads, gen);
+		test_build_same<Tree>(grid, grid_box, 32, 16, threads, gen);
+		test_build_same<Tree>(grid, grid_box, 64, 0, threads, gen);
+	}
+
+	Lab1Points lab1(gen);
+	const auto& handles = lab1.handles;
+
+	test_build_same<Tree>(lab1.points, lab1.box(), Tree::default_capacity, Tree::default_depth, std::thread::hardware_concurrency(), gen);
+
+	Tree tree(lab1.box(), Sampler{&lab1.points}, qtree::Allocator<Tree::Node>());
+
+	auto c0 = clock();
+	for (auto handle : handles)
+		tree.insert(handle);
+	c0 = clock() - c0;
+
+	auto c1 = clock();
+	tree.build(handles.begin(), handles.end(), 1);
+	c1 = clock() - c1;
+
+	auto t0 = std::chrono::steady_clock::now();
+	tree.build(handles.begin(), handles.end());
+	f32 t1 = std::chrono::duration<f32>(std::chrono::steady_clock::now() - t0).count();
+
+	std::cout << "insert elapsed: " << (f32)c0 / CLOCKS_PER_SEC << ", build elapsed: " << (f32)c1 / CLOCKS_PER_SEC
+		<< ", parallel build elapsed: " << t1 << std::endl;
+
+	std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+namespace
+{
+	// NOTE : linear tree must give the same query results as the pointer one
+	template<class Linear>
+	void test_linear_same(const std::vector<qtree::Vec2>& points, const qtree::AABB& box, u32 depth, std::minstd_rand& gen)
+	{
+		using Tree = qtree::Helper<u32, Sampler, qtree::Allocator>::Tree;
+
+		std::vector<u32> handles = make_handles(points.size());
+
+		Tree tree(box, Sampler{&points}, qtree::Allocator<Tree::Node>());
+		tree.build(handles.begin(), handles.end());
+
+		Linear linear(box, Sampler{&points}, depth);
+		linear.build(handles.begin(), handles.end());
+		assert(linear.size() == points.size());
+		assert(std::is_sorted(linear.entries().begin(), linear.entries().end(),
+			[] (const auto& e0, const auto& e1) {return e0.code < e1.code;}));
+
+		auto check = [&] ()
+		{
+			std::vector<u32> r0;
+			std::vector<u32> r1;
+			for (u32 i = 0; i < 50; i++)
+			{
+				// query boxes may stick out of the tree box
+				qtree::AABB frame = random_box(box, 0.1, gen);
+				tree.query(frame, r0);
+				linear.query(frame, r1);
+
+				std::sort(r0.begin(), r0.end());
+				std::sort(r1.begin(), r1.end());
+				assert(r0 == r1);
+			}
+		};
+		check();
+
+		// half of elements are removed and inserted back one by one
+		shuffle(handles, gen);
+		for (u32 i = 0; i < handles.size() / 2; i++)
+		{
+			bool removed = linear.remove(handles[i]);
+			bool removedTwice = linear.remove(handles[i]);
+			bool removedTree = tree.remove(handles[i]);
+			assert(removed && !removedTwice && removedTree);
+		}
+		check();
+
+		for (u32 i = 0; i < handles.size() / 2; i++)
+		{
+			bool inserted = linear.insert(handles[i]);
+			bool insertedTwice = linear.insert(handles[i]);
+			bool insertedTree = tree.insert(handles[i]);
+			assert(inserted && !insertedTwice && insertedTree);
+		}
+		check();
+	}
+}
+
+void test_linear_quadtree()
+{
+	std::cout << "*********************************" << std::endl;
+	std::cout << "**** testing linear quadtree ****" << std::endl;
+	std::cout << "*********************************" << std::endl;
+
+	using Vec2 = qtree::Vec2;
+	using Float = Vec2::value_type;
+	using Tree = qtree::Helper<u32, Sampler, CountingAllocator, CountingStdAllocator>::Tree;
+	using Linear = qtree::LinearQuadTree<u32, Sampler>;
+
+	std::random_device device;
+	auto seed = device();
+	std::minstd_rand gen(seed);
+
+	std::cout << "seed: " << seed << std::endl;
+
+	std::vector<Vec2> grid = coarse_grid(5000, gen);
+
+	test_linear_same<Linear>(grid, grid_box, 1, gen);
+	test_linear_same<Linear>(grid, grid_box, 5, gen);
+	test_linear_same<Linear>(grid, grid_box, 16, gen);
+	test_linear_same<qtree::LinearQuadTree<u32, Sampler, u64>>(grid, grid_box, 32, gen);
+
+	const u32 queries = 1000;
+
+	Lab1Points lab1(gen);
+	const auto& handles = lab1.handles;
+
+	Tree tree(lab1.box(), Sampler{&lab1.points}, Tree::NodeAllocator());
+	Linear linear(lab1.box(), Sampler{&lab1.points});
+
+	allocations = 0;
+	tree.build(handles.begin(), handles.end(), 1);
+
+	u64 treeMemory = (u64)tree.nodes() * sizeof(Tree::Node) + (u64)lab1.count * sizeof(u32);
+	std::cout << "quadtree nodes: " << tree.nodes() << ", allocations: " << allocations
+		<< ", memory (lower bound): " << treeMemory << std::endl;
+
+	linear.build(handles.begin(), handles.end(), 1);
+	std::cout << "linear quadtree memory: " << linear.memory() << std::endl;
+
+	std::vector<qtree::AABB> frames;
+	for (u32 i = 0; i < queries; i++)
+		frames.push_back(lab1.frame(gen, 0.1));
+
+	std::vector<u32> result;
+	u64 total0 = 0;
+	u64 total1 = 0;
+
+	auto c0 = clock();
+	for (auto& frame : frames)
+	{
+		tree.query(frame, result);
+		total0 += result.size();
+	}
+	c0 = clock() - c0;
+
+	auto c1 = clock();
+	for (auto& frame : frames)
+	{
+		linear.query(frame, result);
+		total1 += result.size();
+	}
+	c1 = clock() - c1;
+
+	assert(total0 == total1);
+	std::cout << "quadtree query elapsed: " << (f32)c0 / CLOCKS_PER_SEC
+		<< ", linear quadtree query elapsed: " << (f32)c1 / CLOCKS_PER_SEC << std::endl;
+
+	std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+namespace
+{
+	f64 dist2(const qtree::Vec2& v0, const qtree::Vec2& v1)
+	{
+		auto d = v1 - v0;
+		return d.x * d.x + d.y * d.y;
+	}
+
+	// NOTE : nearest & within must agree with linear scan, nearest is compared by distances as ties go in any order
+	template<class Tree>
+	void test_proximity_same(const std::vector<qtree::Vec2>& points, const qtree::AABB& box, u32 capacity, u32 depth, std::minstd_rand& gen)
+	{
+		using Vec2 = qtree::Vec2;
+
+		std::vector<u32> handles = make_handles(points.size());
+
+		Tree tree(box, Sampler{&points}, qtree::Allocator<typename Tree::Node>(), capacity, depth);
+		for (auto handle : handles)
+			tree.insert(handle);
+
+		// searches don't modify the tree
+		const Tree& view = tree;
+
+		std::vector<u32> result;
+		std::vector<u32> expected;
+		for (u32 i = 0; i < 200; i++)
+		{
+			// query points may lie out of the tree box
+			Vec2 pos = random_point(box, 0.2, gen);
+
+			std::vector<u32> sorted = handles;
+			std::sort(sorted.begin(), sorted.end(), [&] (u32 h0, u32 h1) {return dist2(points[h0], pos) < dist2(points[h1], pos);});
+
+			u32 k = gen() % 40;
+			view.nearest(pos, k, result);
+			assert(result.size() == std::min<u64>(k, points.size()));
+			for (u32 j = 0; j < result.size(); j++)
+				assert(dist2(points[result[j]], pos) == dist2(points[sorted[j]], pos));
+
+			auto radius = std::min(box.v1.x - box.v0.x, box.v1.y - box.v0.y) * (gen() % 1000) / 4000;
+			view.within(pos, radius, result);
+			expected.clear();
+			for (auto handle : handles)
+				if (dist2(points[handle], pos) <= radius * radius)
+					expected.push_back(handle);
+
+			std::sort(result.begin(), result.end());
+			assert(result == expected);
+		}
+
+		tree.nearest(box.v0, 0, result);
+		assert(result.empty());
+		tree.within(box.v0, -1, result);
+		assert(result.empty());
+	}
+}
+
+void test_quadtree_proximity()
+{
+	std::cout << "************************************" << std::endl;
+	std::cout << "**** testing quadtree proximity ****" << std::endl;
+	std::cout << "************************************" << std::endl;
+
+	using Vec2 = qtree::Vec2;
+	using Float = Vec2::value_type;
+	using Tree = qtree::Helper<u32, Sampler, qtree::Allocator>::Tree;
+
+	std::random_device device;
+	auto seed = device();
+	std::minstd_rand gen(seed);
+
+	std::cout << "seed: " << seed << std::endl;
+
+	std::vector<Vec2> grid = coarse_grid(3000, gen);
+
+	std::vector<Vec2> random;
+	for (u32 i = 0; i < 3000; i++)
+		random.push_back(Vec2{(Float)(gen() % 100000) * 1e-3, (Float)(gen() % 100000) * 1e-3});
+
+	test_proximity_same<Tree>(grid, grid_box, 1, 8, gen);
+	test_proximity_same<Tree>(grid, grid_box, 32, 16, gen);
+	test_proximity_same<Tree>(random, grid_box, 4, 12, gen);
+	test_proximity_same<Tree>(std::vector<Vec2>(10, Vec2{50, 50}), grid_box, 4, 12, gen);
+	test_proximity_same<Tree>(std::vector<Vec2>{}, grid_box, 4, 12, gen);
+
+	const u32 queries = 100'000;
+
+	Lab1Points lab1(gen);
+	const auto& points = lab1.points;
+	const auto& handles = lab1.handles;
+
+	Tree tree(lab1.box(), Sampler{&points}, qtree::Allocator<Tree::Node>());
+	tree.build(handles.begin(), handles.end());
+
+	std::vector<u32> result;
+
+	auto c0 = clock();
+	for (u32 i = 0; i < queries; i++)
+		tree.nearest(lab1.point(gen), 1, result);
+	c0 = clock() - c0;
+
+	auto c1 = clock();
+	for (u32 i = 0; i < queries; i++)
+		tree.nearest(lab1.point(gen), 16, result);
+	c1 = clock() - c1;
+
+	auto c2 = clock();
+	for (u32 i = 0; i < queries; i++)
+		tree.within(lab1.point(gen), 5, result);
+	c2 = clock() - c2;
+
+	// linear scan as it is done without the tree
+	std::vector<Vec2> positions;
+	for (u32 i = 0; i < 100; i++)
+		positions.push_back(lab1.point(gen));
+
+	std::vector<u32> found;
+	auto c3 = clock();
+	for (auto& pos : positions)
+		found.push_back(*std::min_element(handles.begin(), handles.end(), [&] (u32 h0, u32 h1) {return dist2(points[h0], pos) < dist2(points[h1], pos);}));
+	c3 = clock() - c3;
+
+	for (u32 i = 0; i < positions.size(); i++)
+	{
+		tree.nearest(positions[i], 1, result);
+		assert(dist2(points[result[0]], positions[i]) == dist2(points[found[i]], positions[i]));
+	}
+
+	std::cout << "per query, nearest: " << (f32)c0 / CLOCKS_PER_SEC / queries << ", 16 nearest: " << (f32)c1 / CLOCKS_PER_SEC / queries
+		<< ", within: " << (f32)c2 / CLOCKS_PER_SEC / queries << ", linear scan: " << (f32)c3 / CLOCKS_PER_SEC / 100 << std::endl;
+
+	std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+namespace
+{
+	// NOTE : count & span query must agree with query
+	template<class Tree>
+	void test_counts_same(Tree& tree, const qtree::AABB& box, std::minstd_rand& gen)
+	{
+		std::vector<u32> result;
+		std::vector<u32> partial;
+		std::vector<std::span<const u32>> spans;
+		for (u32 i = 0; i < 20; i++)
+		{
+			qtree::AABB frame = random_box(box, 0.1, gen);
+			tree.query(frame, result);
+			assert(tree.count(frame) == result.size());
+
+			tree.query(frame, spans, partial);
+			for (auto span : spans)
+				partial.insert(partial.end(), span.begin(), span.end());
+
+			std::sort(result.begin(), result.end());
+			std::sort(partial.begin(), partial.end());
+			assert(result == partial);
+		}
+		assert(tree.count(box) == tree.size());
+	}
+}
+
+void test_quadtree_counts()
+{
+	std::cout << "*********************************" << std::endl;
+	std::cout << "**** testing quadtree counts ****" << std::endl;
+	std::cout << "*********************************" << std::endl;
+
+	using Vec2 = qtree::Vec2;
+	using Float = Vec2::value_type;
+	using Tree = qtree::Helper<u32, Sampler, qtree::Allocator>::Tree;
+
+	std::random_device device;
+	auto seed = device();
+	std::minstd_rand gen(seed);
+
+	std::cout << "seed: " << seed << std::endl;
+
+	std::vector<Vec2> grid = coarse_grid(4000, gen);
+
+	for (u32 capacity : {1, 4, 32})
+	{
+		Tree tree(grid_box, Sampler{&grid}, qtree::Allocator<Tree::Node>(), capacity, 8);
+		assert(tree.empty());
+
+		std::vector<bool> present(grid.size());
+		u32 size = 0;
+		for (u32 i = 0; i < 40000; i++)
+		{
+			u32 handle = gen() % grid.size();
+			if (gen() % 3 != 0)
+				size += tree.insert(handle);
+			else
+				size -= tree.remove(handle);
+
+			if (i % 4000 == 0)
+			{
+				assert(tree.size() == size);
+				assert(tree.countInvariant());
+				test_counts_same(tree, grid_box, gen);
+			}
+		}
+		assert(tree.countInvariant());
+
+		std::vector<u32> handles = make_handles(grid.size());
+		tree.build(handles.begin(), handles.end());
+		assert(tree.size() == grid.size());
+		assert(tree.countInvariant());
+		test_counts_same(tree, grid_box, gen);
+
+		tree.clear();
+		assert(tree.empty() && tree.countInvariant());
+	}
+
+	const u32 queries = 1000;
+
+	Lab1Points lab1(gen);
+
+	Tree tree(lab1.box(), Sampler{&lab1.points}, qtree::Allocator<Tree::Node>());
+	tree.build(lab1.handles.begin(), lab1.handles.end());
+
+	std::vector<qtree::AABB> frames;
+	for (u32 i = 0; i < queries; i++)
+		frames.push_back(lab1.frame(gen, 0.3));
+
+	std::vector<u32> result;
+	std::vector<u32> partial;
+	std::vector<std::span<const u32>> spans;
+	u64 total0 = 0;
+	u64 total1 = 0;
+	u64 total2 = 0;
+
+	auto c0 = clock();
+	for (auto& frame : frames)
+	{
+		tree.query(frame, result);
+		total0 += result.size();
+	}
+	c0 = clock() - c0;
+
+	auto c1 = clock();
+	for (auto& frame : frames)
+	{
+		tree.query(frame, spans, partial);
+		total1 += partial.size();
+		for (auto span : spans)
+			total1 += span.size();
+	}
+	c1 = clock() - c1;
+
+	auto c2 = clock();
+	for (auto& frame : frames)
+		total2 += tree.count(frame);
+	c2 = clock() - c2;
+
+	assert(total0 == total1 && total0 == total2);
+	std::cout << "query elapsed: " << (f32)c0 / CLOCKS_PER_SEC << ", span query elapsed: " << (f32)c1 / CLOCKS_PER_SEC
+		<< ", count elapsed: " << (f32)c2 / CLOCKS_PER_SEC << std::endl;
+
+	std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+namespace
+{
+	// visits elements one by one
+	struct ElemVisitor
+	{
+		void operator () (u32 handle)
+		{
+			handles.push_back(handle);
+		}
+
+		std::vector<u32>& handles;
+	};
+
+	// visits at most limit elements, whole leaves are visited at once
+	struct LimitedVisitor
+	{
+		bool operator () (u32 handle)
+		{
+			handles.push_back(handle);
+			return handles.size() < limit;
+		}
+
+		bool operator () (std::span<const u32> range)
+		{
+			for (auto handle : range)
+				if (!(*this)(handle))
+					return false;
+			return true;
+		}
+
+		std::vector<u32>& handles;
+		u64 limit{};
+	};
+
+	// same as recoloring in Lab1
+	struct ColorVisitor
+	{
+		void operator () (u32 handle)
+		{
+			colors[handle] = color;
+			handles.push_back(handle);
+		}
+
+		void operator () (std::span<const u32> range)
+		{
+			for (auto handle : range)
+				colors[handle] = color;
+			handles.insert(handles.end(), range.begin(), range.end());
+		}
+
+		u32* colors{};
+		u32 color{};
+		std::vector<u32>& handles;
+	};
+}
+
+void test_quadtree_visitor()
+{
+	std::cout << "**********************************" << std::endl;
+	std::cout << "**** testing quadtree visitor ****" << std::endl;
+	std::cout << "**********************************" << std::endl;
+
+	using Tree = qtree::Helper<u32, Sampler, qtree::Allocator>::Tree;
+
+	std::random_device device;
+	auto seed = device();
+	std::minstd_rand gen(seed);
+
+	std::cout << "seed: " << seed << std::endl;
+
+	const u32 count = Lab1Points::count;
+	const u32 queries = 1000;
+
+	Lab1Points lab1(gen);
+
+	Tree tree(lab1.box(), Sampler{&lab1.points}, qtree::Allocator<Tree::Node>());
+	tree.build(lab1.handles.begin(), lab1.handles.end());
+
+	std::vector<qtree::AABB> frames;
+	for (u32 i = 0; i < queries; i++)
+		frames.push_back(lab1.frame(gen, 0.3));
+
+	std::vector<u32> result;
+	std::vector<u32> visited;
+	for (u32 i = 0; i < 50; i++)
+	{
+		tree.query(frames[i], result);
+
+		visited.clear();
+		bool completed = tree.forEachIn(frames[i], ElemVisitor{visited});
+		assert(completed && visited == result);
+
+		visited.clear();
+		completed = tree.forEachIn(frames[i], LimitedVisitor{visited, count});
+		assert(completed && visited == result);
+
+		// early exit
+		u64 limit = gen() % (result.size() + 1) + 1;
+		visited.clear();
+		completed = tree.forEachIn(frames[i], LimitedVisitor{visited, limit});
+		assert(completed == (limit > result.size()));
+		assert(visited.size() == std::min<u64>(limit, result.size()));
+		assert(std::equal(visited.begin(), visited.end(), result.begin()));
+	}
+
+	// Lab1 recoloring: query & pass over the result against streaming
+	std::vector<u32> colors(count);
+	result.reserve(count);
+	visited.reserve(count);
+
+	auto c0 = clock();
+	for (u32 i = 0; i < queries; i++)
+	{
+		tree.query(frames[i], result);
+		for (auto handle : result)
+			colors[handle] = i;
+	}
+	c0 = clock() - c0;
+
+	auto c1 = clock();
+	for (u32 i = 0; i < queries; i++)
+	{
+		visited.clear();
+		tree.forEachIn(frames[i], ColorVisitor{colors.data(), i, visited});
+	}
+	c1 = clock() - c1;
+
+	std::cout << "query & pass elapsed: " << (f32)c0 / CLOCKS_PER_SEC << ", forEachIn elapsed: " << (f32)c1 / CLOCKS_PER_SEC << std::endl;
+
+	std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+void test_quadtree_batch()
+{
+	std::cout << "********************************" << std::endl;
+	std::cout << "**** testing quadtree batch ****" << std::endl;
+	std::cout << "********************************" << std::endl;
+
+	using Vec2 = qtree::Vec2;
+	using Float = Vec2::value_type;
+	using Tree = qtree::Helper<u32, Sampler, qtree::Allocator>::Tree;
+
+	std::random_device device;
+	auto seed = device();
+	std::minstd_rand gen(seed);
+
+	std::cout << "seed: " << seed << std::endl;
+
+	const u32 queries = 10'000;
+	const Float w = Lab1Points::w;
+	const Float h = Lab1Points::h;
+
+	Lab1Points lab1(gen);
+
+	Tree tree(lab1.box(), Sampler{&lab1.points}, qtree::Allocator<Tree::Node>());
+	tree.build(lab1.handles.begin(), lab1.handles.end());
+
+	// small boxes, some of them stick out of the tree box
+	std::vector<qtree::AABB> frames;
+	for (u32 i = 0; i < queries; i++)
+	{
+		Vec2 p = random_point(lab1.box(), 0.05, gen);
+		frames.push_back({p, {p.x + 0.01 * w * (1 + gen() % 4), p.y + 0.01 * h * (1 + gen() % 4)}});
+	}
+
+	std::vector<u32> elems;
+	std::vector<std::span<const u32>> results;
+
+	tree.queryBatch({}, elems, results);
+	assert(elems.empty() && results.empty());
+
+	std::vector<u32> result;
+	for (u32 threads : {1, 2, 4})
+	{
+		tree.queryBatch(frames, elems, results, threads);
+		assert(results.size() == frames.size());
+		for (u32 i = 0; i < queries; i++)
+		{
+			tree.query(frames[i], result);
+			assert(std::equal(result.begin(), result.end(), results[i].begin(), results[i].end()));
+		}
+	}
+
+	// output storage large enough is reused as is
+	for (u32 batch : {10u, queries})
+	{
+		auto elemsData = elems.data();
+		auto resultsData = results.data();
+		tree.queryBatch(std::span(frames).first(batch), elems, results, 1);
+
+		assert(elems.data() == elemsData);
+		assert(results.data() == resultsData);
+	}
+
+	auto c0 = std::chrono::steady_clock::now();
+	u64 total0 = 0;
+	for (auto& frame : frames)
+	{
+		tree.query(frame, result);
+		total0 += result.size();
+	}
+	f32 t0 = std::chrono::duration<f32>(std::chrono::steady_clock::now() - c0).count();
+
+	auto c1 = std::chrono::steady_clock::now();
+	tree.queryBatch(frames, elems, results, 1);
+	f32 t1 = std::chrono::duration<f32>(std::chrono::steady_clock::now() - c1).count();
+
+	auto c2 = std::chrono::steady_clock::now();
+	tree.queryBatch(frames, elems, results);
+	f32 t2 = std::chrono::duration<f32>(std::chrono::steady_clock::now() - c2).count();
+
+	assert(total0 == elems.size());
+	std::cout << "threads: " << std::thread::hardware_concurrency() << ", queries elapsed: " << t0
+		<< ", batch elapsed: " << t1 << ", parallel batch elapsed: " << t2 << std::endl;
+
+	std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+namespace
+{
+	// NOTE : tree built in parallel must be the same as one built sequentially
+	template<class Tree>
+	void test_build_parallel_same(const std::vector<qtree::Vec2>& points, const qtree::AABB& box, u32 capacity, u32 depth, u32 threads, std::minstd_rand& gen)
+	{
+		std::vector<u32> handles = make_handles(points.size());
+
+		Tree built(box, Sampler{&points}, typename Tree::NodeAllocator(), capacity, depth);
+		built.build(handles.begin(), handles.end(), 1);
+
+		Tree parallel(box, Sampler{&points}, typename Tree::NodeAllocator(), capacity, depth);
+		parallel.buildParallel(handles.begin(), handles.end(), threads);
+
+		assert(parallel.nodes() == built.nodes());
+		assert(parallel.depth() == built.depth());
+		assert(parallel.size() == built.size());
+		assert(parallel.countInvariant());
+
+		std::vector<u32> r0;
+		std::vector<u32> r1;
+		for (u32 i = 0; i < 20; i++)
+		{
+			qtree::AABB frame = random_box(box, 0, gen);
+			built.query(frame, r0);
+			parallel.query(frame, r1);
+			assert(r0 == r1);
+		}
+
+		shuffle(handles, gen);
+		for (auto handle : handles)
+		{
+			bool removed = parallel.remove(handle);
+			assert(removed);
+		}
+		assert(parallel.nodes() == 1 && parallel.empty());
+	}
+}
+
+void test_quadtree_build_parallel()
+{
+	std::cout << "*****************************************" << std::endl;
+	std::cout << "**** testing quadtree parallel build ****" << std::endl;
+	std::cout << "*****************************************" << std::endl;
+
+	using Vec2 = qtree::Vec2;
+	using Float = Vec2::value_type;
+	using Tree = qtree::Helper<u32, Sampler, qtree::Allocator>::Tree;
+	using PoolTree = qtree::Helper<u32, Sampler, PoolStorage>::Tree;
+
+	std::random_device device;
+	auto seed = device();
+	std::minstd_rand gen(seed);
+
+	std::cout << "seed: " << seed << std::endl;
+
+	std::vector<Vec2> grid = coarse_grid(20000, gen);
+
+	for (u32 threads : {1, 2, 3, 8})
+	{
+		test_build_parallel_same<Tree>(grid, grid_box, 1, 8, threads, gen);
+		test_build_parallel_same<Tree>(grid, grid_box, 32, 16, threads, gen);
+		test_build_parallel_same<Tree>(grid, grid_box, 64, 1, threads, gen);
+		test_build_parallel_same<Tree>(grid, grid_box, 64, 0, threads, gen);
+		test_build_parallel_same<Tree>(std::vector<Vec2>(100, Vec2{50, 50}), grid_box, 4, 16, threads, gen);
+		test_build_parallel_same<Tree>(std::vector<Vec2>{}, grid_box, 4, 16, threads, gen);
+
+		// workers allocate nodes from their own pools, the tree takes them over
+		test_build_parallel_same<PoolTree>(grid, grid_box, 1, 8, threads, gen);
+		test_build_parallel_same<PoolTree>(grid, grid_box, 32, 16, threads, gen);
+	}
+
+	Lab1Points lab1(gen);
+	const auto& handles = lab1.handles;
+
+	Tree tree(lab1.box(), Sampler{&lab1.points}, qtree::Allocator<Tree::Node>());
+
+	auto c0 = std::chrono::steady_clock::now();
+	tree.build(handles.begin(), handles.end());
+	f32 t0 = std::chrono::duration<f32>(std::chrono::steady_clock::now() - c0).count();
+
+	auto c1 = std::chrono::steady_clock::now();
+	tree.buildParallel(handles.begin(), handles.end());
+	f32 t1 = std::chrono::duration<f32>(std::chrono::steady_clock::now() - c1).count();
+
+	std::cout << "threads: " << std::thread::hardware_concurrency() << ", build elapsed: " << t0 << ", parallel build elapsed: " << t1 << std::endl;
+
+	std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+void test_quadtree_delta()
+{
+	std::cout << "********************************" << std::endl;
+	std::cout << "**** testing quadtree delta ****" << std::endl;
+	std::cout << "********************************" << std::endl;
+
+	using Vec2 = qtree::Vec2;
+	using Float = Vec2::value_type;
+	using Tree = qtree::Helper<u32, Sampler, qtree::Allocator>::Tree;
+
+	std::random_device device;
+	auto seed = device();
+	std::minstd_rand gen(seed);
+
+	std::cout << "seed: " << seed << std::endl;
+
+	// coarse grid so that many points lie on the boundaries of boxes
+	std::vector<Vec2> grid;
+	for (u32 i = 0; i < 20000; i++)
+		grid.push_back(Vec2{(Float)(gen() % 100), (Float)(gen() % 100)});
+
+	std::vector<u32> handles = make_handles(grid.size());
+
+	Tree tree({{0, 0}, {100, 100}}, Sampler{&grid}, qtree::Allocator<Tree::Node>(), 4, 10);
+	tree.build(handles.begin(), handles.end());
+
+	auto genBox = [&] ()
+	{
+		Float x0 = (Float)(gen() % 110) - 5;
+		Float x1 = (Float)(gen() % 110) - 5;
+		Float y0 = (Float)(gen() % 110) - 5;
+		Float y1 = (Float)(gen() % 110) - 5;
+		return qtree::AABB{{std::min(x0, x1), std::min(y0, y1)}, {std::max(x0, x1), std::max(y0, y1)}};
+	};
+
+	std::vector<u32> entered;
+	std::vector<u32> left;
+	std::vector<u32> expectedEntered;
+	std::vector<u32> expectedLeft;
+	for (u32 i = 0; i < 2000; i++)
+	{
+		auto from = genBox();
+		auto to = i % 4 == 0 ? from : genBox();
+		if (i % 4 == 1)
+		{
+			// shift
+			Vec2 d{(Float)(gen() % 7) - 3, (Float)(gen() % 7) - 3};
+			to = {from.v0 + d, from.v1 + d};
+		}
+
+		tree.queryDelta(from, to, entered, left);
+
+		expectedEntered.clear();
+		expectedLeft.clear();
+		for (auto handle : handles)
+		{
+			bool inFrom = prim::inAABB(from, grid[handle]);
+			bool inTo = prim::inAABB(to, grid[handle]);
+			if (inTo && !inFrom)
+				expectedEntered.push_back(handle);
+			if (inFrom && !inTo)
+				expectedLeft.push_back(handle);
+		}
+
+		std::sort(entered.begin(), entered.end());
+		std::sort(left.begin(), left.end());
+		assert(entered == expectedEntered);
+		assert(left == expectedLeft);
+	}
+
+	// early exit
+	auto from = qtree::AABB{{0, 0}, {50, 50}};
+	auto to = qtree::AABB{{10, 10}, {60, 60}};
+	u32 visited = 0;
+	bool completed = tree.forEachDelta(from, to, [&] (u32) {return ++visited < 10;});
+	assert(!completed && visited == 10);
+
+	// Lab1-like drag of the frame
+	const u32 count = Lab1Points::count;
+	const u32 steps = 1000;
+	const Float w = Lab1Points::w;
+	const Float h = Lab1Points::h;
+
+	Lab1Points lab1(gen);
+
+	Tree big(lab1.box(), Sampler{&lab1.points}, qtree::Allocator<Tree::Node>());
+	big.build(lab1.handles.begin(), lab1.handles.end());
+
+	std::vector<qtree::AABB> frames;
+	for (u32 i = 0; i < steps; i++)
+	{
+		Float x = 0.1 * w + 0.5 * w * i / steps;
+		Float y = 0.1 * h + 0.5 * h * i / steps;
+		frames.push_back({{x, y}, {x + 0.3 * w, y + 0.3 * h}});
+	}
+
+	std::vector<u32> colors(count);
+	std::vector<u32> query;
+
+	auto c0 = clock();
+	for (u32 i = 0; i < steps; i++)
+	{
+		for (auto handle : query)
+			colors[handle] = 0;
+		big.query(frames[i], query);
+		for (auto handle : query)
+			colors[handle] = 1;
+	}
+	c0 = clock() - c0;
+
+	std::vector<u32> check = colors;
+	std::fill(colors.begin(), colors.end(), 0);
+
+	auto c1 = clock();
+	big.forEachIn(frames[0], [&] (u32 handle) {colors[handle] = 1;});
+	for (u32 i = 1; i < steps; i++)
+	{
+		big.forEachDelta(frames[i], frames[i - 1], [&] (u32 handle) {colors[handle] = 0;});
+		big.forEachDelta(frames[i - 1], frames[i], [&] (u32 handle) {colors[handle] = 1;});
+	}
+	c1 = clock() - c1;
+
+	assert(colors == check);
+	std::cout << "query & recolor elapsed: " << (f32)c0 / CLOCKS_PER_SEC << ", delta elapsed: " << (f32)c1 / CLOCKS_PER_SEC << std::endl;
+
+	std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+void test_quadtree_update()
+{
+	std::cout << "*********************************" << std::endl;
+	std::cout << "**** testing quadtree update ****" << std::endl;
+	std::cout << "*********************************" << std::endl;
+
+	using Vec2 = qtree::Vec2;
+	using Float = Vec2::value_type;
+	using Tree = qtree::Helper<u32, Sampler, qtree::Allocator>::Tree;
+
+	std::random_device device;
+	auto seed = device();
+	std::minstd_rand gen(seed);
+
+	std::cout << "seed: " << seed << std::endl;
+
+	// points walk over the coarse grid so many of them share the position
+	for (u32 capacity : {1, 4, 32})
+	{
+		std::vector<Vec2> points;
+		for (u32 i = 0; i < 4000; i++)
+			points.push_back(Vec2{(Float)(gen() % 100), (Float)(gen() % 100)});
+
+		std::vector<u32> handles = make_handles(points.size());
+
+		Tree tree({{0, 0}, {100, 100}}, Sampler{&points}, qtree::Allocator<Tree::Node>(), capacity, 10);
+		tree.build(handles.begin(), handles.end());
+
+		// not present & wrong old position (another quadrant of the root)
+		bool updatedAbsent = tree.update((u32)points.size(), points[0]);
+		bool updatedWrong = tree.update(0, Vec2{points[0].x < 50 ? 99 : 0, points[0].y});
+		assert(!updatedAbsent && !updatedWrong);
+
+		for (u32 step = 0; step < 50; step++)
+		{
+			for (u32 i = 0; i < 400; i++)
+			{
+				u32 handle = gen() % points.size();
+
+				Vec2 old = points[handle];
+				Vec2 d = step % 2 == 0 ? Vec2{(Float)(gen() % 3) - 1, (Float)(gen() % 3) - 1} : Vec2{(Float)(gen() % 100), (Float)(gen() % 100)} - old;
+				points[handle] = Vec2{std::clamp<Float>(old.x + d.x, 0, 99), std::clamp<Float>(old.y + d.y, 0, 99)};
+
+				// element stays in the same leaf: structure must not change
+				const auto* leaf = tree.leafOf(old);
+				bool sameLeaf = leaf == tree.leafOf(points[handle]);
+				auto data = leaf->data;
+				u32 nodes = tree.nodes();
+
+				bool updated = tree.update(handle, old);
+				assert(updated);
+				if (sameLeaf)
+					assert(tree.nodes() == nodes && leaf->data == data);
+
+				const auto& moved = tree.leafOf(points[handle])->data;
+				assert(std::find(moved.begin(), moved.end(), handle) != moved.end());
+			}
+			assert(tree.size() == points.size());
+			assert(tree.countInvariant());
+
+			// content must be the same as the one of a tree built from scratch
+			Tree built({{0, 0}, {100, 100}}, Sampler{&points}, qtree::Allocator<Tree::Node>(), capacity, 10);
+			built.build(handles.begin(), handles.end());
+
+			std::vector<u32> r0;
+			std::vector<u32> r1;
+			for (u32 i = 0; i < 10; i++)
+			{
+				Float x0 = (Float)(gen() % 100);
+				Float x1 = (Float)(gen() % 100);
+				Float y0 = (Float)(gen() % 100);
+				Float y1 = (Float)(gen() % 100);
+
+				qtree::AABB frame{{std::min(x0, x1), std::min(y0, y1)}, {std::max(x0, x1), std::max(y0, y1)}};
+				tree.query(frame, r0);
+				built.query(frame, r1);
+
+				std::sort(r0.begin(), r0.end());
+				std::sort(r1.begin(), r1.end());
+				assert(r0 == r1);
+			}
+		}
+
+		for (auto handle : handles)
+		{
+			bool removed = tree.remove(handle);
+			assert(removed);
+		}
+		assert(tree.nodes() == 1 && tree.empty());
+	}
+
+	// Lab1-like point cloud jittered every frame
+	const u32 count = Lab1Points::count;
+	const u32 frames = 4;
+
+	std::uniform_real_distribution<Float> genD(-1, 1);
+
+	Lab1Points lab1(gen);
+	auto& points = lab1.points;
+
+	std::vector<Vec2> old(count);
+	std::vector<Vec2> moved(count);
+
+	Tree tree(lab1.box(), Sampler{&points}, qtree::Allocator<Tree::Node>());
+	tree.build(lab1.handles.begin(), lab1.handles.end());
+
+	// remove with old positions & insert with new ones
+	clock_t c0 = 0;
+	for (u32 frame = 0; frame < frames; frame++)
+	{
+		for (u32 i = 0; i < count; i++)
+			moved[i] = points[i] + Vec2{genD(gen), genD(gen)};
+
+		auto c = clock();
+		for (u32 i = 0; i < count; i++)
+		{
+			tree.remove(i);
+			points[i] = moved[i];
+			tree.insert(i);
+		}
+		c0 += clock() - c;
+	}
+
+	clock_t c1 = 0;
+	for (u32 frame = 0; frame < frames; frame++)
+	{
+		old = points;
+		for (u32 i = 0; i < count; i++)
+			points[i] = points[i] + Vec2{genD(gen), genD(gen)};
+
+		auto c = clock();
+		for (u32 i = 0; i < count; i++)
+			tree.update(i, old[i]);
+		c1 += clock() - c;
+	}
+	assert(tree.size() == count);
+	assert(tree.countInvariant());
+
+	std::cout << "remove & insert elapsed: " << (f32)c0 / CLOCKS_PER_SEC << ", update elapsed: " << (f32)c1 / CLOCKS_PER_SEC << std::endl;
+
+	std::cout << "testing ended" << std::endl << std::endl;
+}
@@ -27,3 +27,25 @@ auto create_vecs(const Vec& v0, const Vec& v1, i32 div)
 
 
 void test_simple_quadtree();
+
+void test_quadtree_allocations();
+
+void test_quadtree_buckets();
+
+void test_quadtree_build();
+
+void test_linear_quadtree();
+
+void test_quadtree_proximity();
+
+void test_quadtree_counts();
+
+void test_quadtree_visitor();
+
+void test_quadtree_batch();
+
+void test_quadtree_build_parallel();
+
+void test_quadtree_delta();
+
+void test_quadtree_update();
@@ -8,6 +8,7 @@
 #include <vector>
 #include <cassert>
 #include <utility>
+#include <iterator>
 #include <algorithm>
 
 //#define DEBUG_SEGMENTS
@@ -82,8 +83,11 @@ namespace sect
 		using Sampler = sampler_t;
 
 		// sweep line, multiset-like
+		// NOTE : transparent, sweep line can be searched by x coordinate directly
 		struct SweepLineComparator
 		{
+			using is_transparent = void;
+
 			SweepLineComparator(Sampler samp, Float eps) : sampler(samp)
 			{}
 
@@ -131,7 +135,8 @@ namespace sect
 			Vec2 sweep{};
 		};
 
-		using sweep_line_traits_t = trb::TreeTraits<Handle, SweepLineComparator, trb::DefaultAllocator, false, true>;
+		// counted: distance between bounds of an event bundle is computed in O(log n)
+		using sweep_line_traits_t = trb::TreeTraits<Handle, SweepLineComparator, trb::DefaultAllocator, false, true, true>;
 
 		class SweepLine : public trb::Tree<sweep_line_traits_t>
 		{
@@ -188,8 +193,11 @@ namespace sect
 			std::vector<Handle> upperEnd;
 		};
 
+		// NOTE : transparent, event queue can be searched by point directly
 		struct PointEventComparator
 		{
+			using is_transparent = void;
+
 			// for searching & insertion
 			bool operator () (const PointEvent& e0, const PointEvent& e1)
 			{
@@ -252,12 +260,9 @@ namespace sect
 		};
 
 
-		using SweepLineEx  = typename SweepLine::Extract;
 		using SweepLineIt  = typename SweepLine::Iterator;
 		using PointEventIt = typename EventQueue::Iterator;
 
-		using ExtractBuffer = std::vector<SweepLineEx>;
-
 	public:
 		Sector(const std::vector<Handle>& lines, Sampler sampler, Float eps) 
 			: m_sweepLine(sampler, eps)
@@ -294,25 +299,47 @@ namespace sect
 			std::cout << "*** init ***" << std::endl;
 			#endif
 
+			// events are sorted once and the queue is built in linear time
+			// stable sort keeps segments sharing upper end in the input order
+			std::vector<PointEvent> events;
+			events.reserve(lines.size());
 			for (auto& line : lines)
-				insertUpperEndEvent(line);
+			{
+				auto [v0, v1] = reorder_line(m_sampler(line), m_eps);
 
-			#ifdef DEBUG_SEGMENTS
-			std::cout << std::endl;
-			#endif
-		}
+				events.push_back(PointEvent{v0, {}, {line}});
 
+				#ifdef DEBUG_SEGMENTS
+				std::cout << "upper: " << v0 << std::endl;
+				#endif
+			}
 
-		// NOTE : called only from initialization step, line hasn't been inserted yet, so pure line is passed
-		void insertUpperEndEvent(Handle l)
-		{
-			auto [v0, v1] = reorder_line(m_sampler(l), m_eps);
+			PointEventComparator compare{m_eps};
+			std::stable_sort(events.begin(), events.end(), compare);
+
+			// merge events with equal points
+			auto last = events.begin();
+			for (auto curr = events.begin(); curr != events.end(); ++curr)
+			{
+				if (curr == last)
+					continue;
+
+				if (!compare(last->point, *curr))
+				{
+					last->upperEnd.push_back(curr->upperEnd.front());
+					continue;
+				}
+
+				if (++last != curr)
+					*last = std::move(*curr);
+			}
+			if (!events.empty())
+				events.erase(++last, events.end());
 
-			auto [it, _] = m_eventQueue.insert(v0);
-			it->upperEnd.push_back(l);
+			m_eventQueue.assignSorted(std::make_move_iterator(events.begin()), std::make_move_iterator(events.end()));
 
 			#ifdef DEBUG_SEGMENTS
-			std::cout << "upper: " << v0 << std::endl;
+			std::cout << std::endl;
 			#endif
 		}
 
@@ -392,7 +419,7 @@ namespace sect
 			u32 intersections = 0u;
 			if (l0 != m_sweepLine.end())
 			{
-				intersections += std::distance(l0, l1);
+				intersections += l1 - l0;
 				intersections -= m_event.lowerEnd.size();
 			}
 			return intersections;
@@ -422,16 +449,14 @@ namespace sect
 				m_sweepLine.erase(it);
 		}
 
-		void extractIntersecting()
+		// NOTE : intersecting segments are a run of equal keys, their nodes are relinked in reversed order
+		// so lower-end events keep valid iterators, returns the reversed run
+		std::pair<SweepLineIt, SweepLineIt> reverseIntersecting()
 		{
 			auto l0 = m_sweepLine.lowerBound(m_event.point.x);
 			auto l1 = m_sweepLine.upperBound(m_event.point.x);
 
-			// extract and reverse
-			m_extractBuffer.clear();
-			while (l0 != l1)
-				m_extractBuffer.push_back(m_sweepLine.extract(l0++));
-			std::reverse(m_extractBuffer.begin(), m_extractBuffer.end());
+			return {m_sweepLine.reverseRange(l0, l1), l1};
 		}
 
 		void insertInterUpper(u32 intersections)
@@ -446,32 +471,18 @@ namespace sect
 
 			std::sort(m_event.upperEnd.begin(), m_event.upperEnd.end(), pred);
 
-			extractIntersecting();
+			auto [e0, e1] = reverseIntersecting();
 
-			auto e0 = m_extractBuffer.begin();
-			auto e1 = m_extractBuffer.end();
+			// NOTE : upper-end segments are merged into the reversed run, each one goes right before
+			// the first intersecting segment that doesn't precede it so the search is skipped
 			auto u0 = m_event.upperEnd.begin();
 			auto u1 = m_event.upperEnd.end();
-			while(e0 != e1 && u0 != u1)
-			{
-				if (pred(**e0, *u0))
-				{
-					auto [inserted, _] = m_sweepLine.insert(std::move(*e0++));
-				}
-				else
-				{
-					auto [inserted, _] = m_sweepLine.insert(*u0++);
-					insertLowerEndEvent(inserted);
-				}
-			}
-			while (e0 != e1)
-			{
-				auto [inserted, _] = m_sweepLine.insert(std::move(*e0++));
-			}
 			while (u0 != u1)
 			{
-				auto [inserted, _] = m_sweepLine.insert(*u0++);
-				insertLowerEndEvent(inserted);
+				while (e0 != e1 && pred(*e0, *u0))
+					++e0;
+
+				insertLowerEndEvent(m_sweepLine.insert(e0, *u0++));
 			}
 		}
 
@@ -517,7 +528,6 @@ namespace sect
 
 
 	private:
-		ExtractBuffer         m_extractBuffer;
 		Intersections<Handle> m_intersections;
 
 		PointEvent m_event;
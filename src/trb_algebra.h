@@ -0,0 +1,173 @@
+#pragma once
+
+#include "core.h"
+#include "trb_util.h"
+
+#include <future>
+#include <thread>
+#include <utility>
+
+namespace trb
+{
+    // join-based set algebra (see join & split in trb_util.h)
+    // NOTE : nodes of both trees must share NIL, nodes of the result are reused from the inputs,
+    // nodes that don't get into the result are passed to dealloc
+    // work is O(m log(n/m + 1)) where m is size of the smaller tree (plus deallocation of dropped nodes)
+    // multiset semantics follow std::set_union, std::set_intersection and std::set_difference:
+    // key occurs max(m, n), min(m, n) and max(m - n, 0) times respectively
+
+    enum class SetOperation
+    {
+        Unite,
+        Intersect,
+        Subtract,
+    };
+
+    // NOTE : O(1) for counted nodes, O(n) otherwise
+    template<class NodeT>
+    u32 tree_size(NodeT* nil, NodeT* root)
+    {
+        if constexpr(NodeT::counted)
+        {
+            return root->subtree.size;
+        }
+        else
+        {
+            if (root == nil)
+                return 0;
+            return tree_size<NodeT>(nil, root->left) + tree_size<NodeT>(nil, root->right) + 1;
+        }
+    }
+
+    // NOTE : splits tree into keys less than key, equal to key and greater than key
+    template<class NodeT, class Compare, class Key>
+    void split(NodeT* nil, NodeT* root, Compare& compare, const Key& key, NodeT*& less, NodeT*& equal, NodeT*& greater)
+    {
+        NodeT* rest = nil;
+        split(nil, root, [&] (const auto& nodeKey) {return compare(nodeKey, key);}, less, rest);
+        split(nil, rest, [&] (const auto& nodeKey) {return !compare(key, nodeKey);}, equal, greater);
+    }
+
+    // NOTE : leaves only first count nodes of the tree, the rest are deallocated
+    template<class NodeT, class Dealloc>
+    NodeT* truncate(NodeT* nil, NodeT* root, u32 count, Dealloc& dealloc)
+    {
+        for (u32 size = tree_size(nil, root); size > count; size--)
+        {
+            NodeT* last = tree_max(nil, root);
+            root = remove(nil, root, last);
+            dealloc(last);
+        }
+        return root;
+    }
+
+    // NOTE : both trees consist of equal keys
+    template<SetOperation op, class NodeT, class Dealloc>
+    NodeT* equal_run_operation(NodeT* nil, NodeT* a, NodeT* b, Dealloc& dealloc)
+    {
+        u32 sizeA = tree_size(nil, a);
+        u32 sizeB = tree_size(nil, b);
+        if constexpr(op == SetOperation::Unite)
+        {
+            if (sizeA < sizeB)
+                std::swap(a, b);
+            clear(nil, b, dealloc);
+            return a;
+        }
+        else if constexpr(op == SetOperation::Intersect)
+        {
+            clear(nil, b, dealloc);
+            return truncate(nil, a, std::min(sizeA, sizeB), dealloc);
+        }
+        else
+        {
+            clear(nil, b, dealloc);
+            return truncate(nil, a, sizeA > sizeB ? sizeA - sizeB : 0u, dealloc);
+        }
+    }
+
+    // NOTE : top depth levels of recursion are run in parallel, compare is copied for each task
+    template<SetOperation op, class NodeT, class Compare, class Dealloc>
+    NodeT* set_operation(NodeT* nil, NodeT* a, NodeT* b, Compare compare, Dealloc dealloc, u32 depth)
+    {
+        if (a == nil || b == nil)
+        {
+            if constexpr(op == SetOperation::Unite)
+            {
+                return a != nil ? a : b;
+            }
+            else if constexpr(op == SetOperation::Intersect)
+            {
+                clear(nil, a, dealloc);
+                clear(nil, b, dealloc);
+                return nil;
+            }
+            else
+            {
+                clear(nil, b, dealloc);
+                return a;
+            }
+        }
+
+        // pivot is the root of the smaller tree (if sizes are known), subtrahend is always used for subtraction
+        NodeT* pivot = b;
+        if constexpr(NodeT::counted && op != SetOperation::Subtract)
+        {
+            if (a->subtree.size < b->subtree.size)
+                pivot = a;
+        }
+
+        // pivot node stays alive during both splits so its key can be referenced
+        const auto& key = pivot->key;
+
+        NodeT* lessA{};
+        NodeT* equalA{};
+        NodeT* greaterA{};
+        NodeT* lessB{};
+        NodeT* equalB{};
+        NodeT* greaterB{};
+        if (pivot == b)
+        {
+            split(nil, b, compare, key, lessB, equalB, greaterB);
+            split(nil, a, compare, key, lessA, equalA, greaterA);
+        }
+        else
+        {
+            split(nil, a, compare, key, lessA, equalA, greaterA);
+            split(nil, b, compare, key, lessB, equalB, greaterB);
+        }
+
+        NodeT* less{};
+        NodeT* greater{};
+        if (depth > 0)
+        {
+            auto task = std::async(std::launch::async, [&] ()
+            {
+                return set_operation<op>(nil, lessA, lessB, compare, dealloc, depth - 1);
+            });
+            greater = set_operation<op>(nil, greaterA, greaterB, compare, dealloc, depth - 1);
+            less = task.get();
+        }
+        else
+        {
+            less    = set_operation<op>(nil, lessA, lessB, compare, dealloc, 0);
+            greater = set_operation<op>(nil, greaterA, greaterB, compare, dealloc, 0);
+        }
+
+        NodeT* equal = equal_run_operation<op>(nil, equalA, equalB, dealloc);
+
+        return join(nil, join(nil, less, equal), greater);
+    }
+
+    // NOTE : count of recursion levels that are run in parallel so that there are about 2 tasks per thread
+    inline u32 parallel_depth(u32 threads)
+    {
+        u32 depth = 0;
+        while (threads > 1)
+        {
+            threads = (threads + 1) / 2;
+            ++depth;
+        }
+        return depth > 0 ? depth + 1 : 0;
+    }
+}
@@ -0,0 +1,336 @@
+#pragma once
+
+#include "core.h"
+#include "trb_persistent.h"
+#include "pool_storage.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cassert>
+#include <utility>
+#include <algorithm>
+#include <functional>
+
+namespace trb
+{
+    // ordered set for many concurrent readers and a single writer
+    //
+    // writer updates persistent tree (see PersistentTree) and publishes new version with a single atomic store,
+    // readers take the current version (snapshot) and search & iterate it without any locks, snapshot never changes
+    // nodes that are not shared with the new version are retired and reclaimed by epoch-based reclamation:
+    // reader announces global epoch in its own slot before it takes the snapshot, writer publishes version,
+    // advances epoch and frees nodes retired before the minimal announced epoch
+    //
+    // NOTE : read operations are wait-free except slot acquisition that spins only if all slots are busy,
+    // readers don't write shared memory except their own slot (one cache line) so reads scale with cores
+    // NOTE : all write operations must be called from one thread (or be externally synchronized)
+    template<class key_t, class compare_t = std::less<key_t>>
+    class ConcurrentTree
+    {
+    public:
+        using Tree    = PersistentTree<key_t, compare_t>;
+        using Node    = typename Tree::Node;
+        using Version = typename Tree::Version;
+        using Key     = key_t;
+        using Compare = compare_t;
+
+        static constexpr const u32 max_readers = 64;
+
+        // count of retired versions after which writer tries to reclaim memory
+        static constexpr const u32 reclaim_threshold = 64;
+
+
+    private:
+        // NOTE : 0 means free slot, otherwise announced epoch
+        struct alignas(64) Slot
+        {
+            std::atomic<u64> epoch{};
+        };
+
+        struct Retired
+        {
+            u64 epoch{};
+            const Version* version{};
+            std::vector<const Node*> nodes;
+        };
+
+
+    public:
+        class Batch;
+
+        // snapshot of the tree, reader holds a slot while it is alive
+        class Reader
+        {
+            friend class ConcurrentTree;
+
+            Reader(const ConcurrentTree* tree) : m_tree{tree}
+            {
+                m_slot = m_tree->acquire();
+                m_version = m_tree->m_current.load(std::memory_order_seq_cst);
+            }
+
+        public:
+            Reader(const Reader&) = delete;
+            Reader(Reader&& another) noexcept
+                : m_tree{std::exchange(another.m_tree, nullptr)}
+                , m_version{std::exchange(another.m_version, nullptr)}
+                , m_slot{std::exchange(another.m_slot, nullptr)}
+            {}
+
+            ~Reader()
+            {
+                if (m_slot != nullptr)
+                    m_slot->epoch.store(0, std::memory_order_release);
+            }
+
+            Reader& operator = (const Reader&) = delete;
+            Reader& operator = (Reader&&) = delete;
+
+        public:
+            u32 size() const
+            {
+                return m_version->size();
+            }
+
+            bool empty() const
+            {
+                return m_version->empty();
+            }
+
+            template<class key_u>
+            const Key* find(key_u&& key) const
+            {
+                return m_tree->m_tree.find(*m_version, std::forward<key_u>(key));
+            }
+
+            template<class key_u>
+            bool contains(key_u&& key) const
+            {
+                return m_tree->m_tree.contains(*m_version, std::forward<key_u>(key));
+            }
+
+            template<class key_u>
+            const Key* lowerBound(key_u&& key) const
+            {
+                return m_tree->m_tree.lowerBound(*m_version, std::forward<key_u>(key));
+            }
+
+            template<class key_u>
+            const Key* upperBound(key_u&& key) const
+            {
+                return m_tree->m_tree.upperBound(*m_version, std::forward<key_u>(key));
+            }
+
+            template<class Visitor>
+            void traverse(Visitor visitor) const
+            {
+                m_tree->m_tree.traverse(*m_version, std::move(visitor));
+            }
+
+            bool invariant() const
+            {
+                return m_tree->m_tree.invariant(*m_version);
+            }
+
+        private:
+            const ConcurrentTree* m_tree{};
+            const Version* m_version{};
+            Slot* m_slot{};
+        };
+
+
+    public:
+        ConcurrentTree(Compare compare = Compare{}) : m_tree(std::move(compare))
+        {
+            m_current.store(m_versions.alloc(), std::memory_order_release);
+        }
+
+        ConcurrentTree(const ConcurrentTree&) = delete;
+        ConcurrentTree(ConcurrentTree&&) = delete;
+
+        // NOTE : there must be no readers left
+        ~ConcurrentTree() = default;
+
+        ConcurrentTree& operator = (const ConcurrentTree&) = delete;
+        ConcurrentTree& operator = (ConcurrentTree&&) = delete;
+
+
+    private:
+        Slot* acquire() const
+        {
+            // NOTE : slot search starts from thread-dependent position so that readers don't collide
+            u32 start = (u32)(std::hash<std::thread::id>()(std::this_thread::get_id()) % max_readers);
+            while (true)
+            {
+                for (u32 i = 0; i < max_readers; i++)
+                {
+                    Slot& slot = m_slots[(start + i) % max_readers];
+
+                    u64 epoch = m_epoch.load(std::memory_order_seq_cst);
+                    u64 expected = 0;
+                    if (slot.epoch.compare_exchange_strong(expected, epoch, std::memory_order_seq_cst))
+                        return &slot;
+                }
+                std::this_thread::yield();
+            }
+        }
+
+        // NOTE : minimal epoch announced by readers, current epoch if there are no readers
+        u64 minEpoch() const
+        {
+            u64 result = m_epoch.load(std::memory_order_seq_cst);
+            for (auto& slot : m_slots)
+            {
+                u64 epoch = slot.epoch.load(std::memory_order_seq_cst);
+                if (epoch != 0)
+                    result = std::min(result, epoch);
+            }
+            return result;
+        }
+
+        void publish(Batch& batch)
+        {
+            const Version* old = m_current.load(std::memory_order_relaxed);
+            const Version* current = m_versions.alloc(batch.m_version);
+
+            Retired retired{m_epoch.load(std::memory_order_relaxed), old, std::move(batch.m_retired)};
+
+            // readers that announced epoch <= retired.epoch can still see old version
+            m_current.store(current, std::memory_order_seq_cst);
+            m_epoch.fetch_add(1, std::memory_order_seq_cst);
+
+            m_retired.push_back(std::move(retired));
+            if (m_retired.size() >= reclaim_threshold)
+                reclaim();
+        }
+
+
+    public: // writer
+        // several updates that readers see at once
+        class Batch
+        {
+            friend class ConcurrentTree;
+
+            Batch(ConcurrentTree* tree) : m_tree{tree}, m_base{tree->current()}, m_version{m_base}
+            {}
+
+            // NOTE : nodes created inside the batch were never published so they are released right away
+            bool apply(Version version)
+            {
+                if (version == m_version)
+                    return false;
+
+                m_tree->m_tree.retired(m_version, version, [&] (const Node* node)
+                {
+                    if (node->stamp > m_base.stamp())
+                        m_tree->m_tree.release(node);
+                    else
+                        m_retired.push_back(node);
+                });
+                m_version = version;
+                return true;
+            }
+
+        public:
+            // NOTE : returns false if key is already present
+            template<class key_u>
+            bool insert(key_u&& key)
+            {
+                return apply(m_tree->m_tree.insert(m_version, std::forward<key_u>(key)));
+            }
+
+            // NOTE : returns false if key is not present
+            template<class key_u>
+            bool erase(key_u&& key)
+            {
+                return apply(m_tree->m_tree.erase(m_version, std::forward<key_u>(key)));
+            }
+
+            Version version() const
+            {
+                return m_version;
+            }
+
+        private:
+            ConcurrentTree* m_tree{};
+            Version m_base;
+            Version m_version;
+            std::vector<const Node*> m_retired;
+        };
+
+        // NOTE : returns false if key is already present
+        template<class key_u>
+        bool insert(key_u&& key)
+        {
+            return update([&] (Batch& batch) {batch.insert(std::forward<key_u>(key));});
+        }
+
+        // NOTE : returns false if key is not present
+        template<class key_u>
+        bool erase(key_u&& key)
+        {
+            return update([&] (Batch& batch) {batch.erase(std::forward<key_u>(key));});
+        }
+
+        // NOTE : update gets Batch&, changes are published when it returns, returns false if nothing has changed
+        template<class Update>
+        bool update(Update update)
+        {
+            Batch batch{this};
+            update(batch);
+            if (batch.m_version == batch.m_base)
+                return false;
+
+            publish(batch);
+            return true;
+        }
+
+        // NOTE : frees memory of versions that no reader can see
+        void reclaim()
+        {
+            u64 epoch = minEpoch();
+
+            auto last = std::partition(m_retired.begin(), m_retired.end(), [&] (const Retired& retired)
+            {
+                return retired.epoch >= epoch;
+            });
+            for (auto it = last; it != m_retired.end(); ++it)
+            {
+                for (auto node : it->nodes)
+                    m_tree.release(node);
+                m_versions.dealloc(const_cast<Version*>(it->version));
+            }
+            m_retired.erase(last, m_retired.end());
+        }
+
+        // NOTE : writer's view of the tree, same as a reader's snapshot taken right now
+        Version current() const
+        {
+            return *m_current.load(std::memory_order_relaxed);
+        }
+
+
+    public: // reader
+        Reader read() const
+        {
+            return Reader{this};
+        }
+
+        // NOTE : count of nodes that are not reclaimed yet
+        u32 nodes() const
+        {
+            return m_tree.nodes();
+        }
+
+
+    private:
+        Tree m_tree;
+        PoolStorage<Version> m_versions;
+        std::vector<Retired> m_retired;
+
+        std::atomic<const Version*> m_current{};
+        mutable std::atomic<u64> m_epoch{1};
+        mutable Slot m_slots[max_readers];
+    };
+}
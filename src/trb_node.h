@@ -1,7 +1,18 @@
 #pragma once
 
+#include "core.h"
+#include "indexed_storage.h"
+
+#include <new>
 #include <type_traits>
 
+// NOTE : msvc ignores standard attribute
+#if defined(_MSC_VER)
+#define TRB_NO_UNIQUE_ADDRESS [[msvc::no_unique_address]]
+#else
+#define TRB_NO_UNIQUE_ADDRESS [[no_unique_address]]
+#endif
+
 namespace trb
 {
     enum class Color : char
@@ -10,12 +21,154 @@ namespace trb
         Red = 1,
     };
 
-    template<class key_t, bool threaded_v>
+    template<class key_t, bool threaded_v, bool counted_v = false, bool indexed_v = false, class augment_t = void>
     struct NodeTraits
     {
         static constexpr bool threaded = threaded_v;
+        static constexpr bool counted  = counted_v;
+        static constexpr bool indexed  = indexed_v;
 
-        using Key = key_t;
+        using Key     = key_t;
+        using Augment = augment_t;
+    };
+
+    // NOTE : subtree size augmentation, nil node always has zero size
+    // empty struct fits into padding after color so not counted nodes don't grow
+    template<bool counted_v>
+    struct NodeSize
+    {
+        u32 size{};
+    };
+
+    template<>
+    struct NodeSize<false>
+    {};
+
+    // NOTE : generic augmentation, node keeps summary of all keys of its subtree
+    // augment_t describes a monoid over keys:
+    // 1) using Summary = ... - summary type
+    // 2) static Summary identity() - summary of an empty subtree, nil node always keeps it
+    // 3) static Summary lift(const Key& key) - summary of a single key
+    // 4) static Summary combine(const Summary& left, const Summary& right) - must be associative,
+    // keys of left precede keys of right
+    // void means no augmentation, empty struct doesn't take space
+    template<class augment_t>
+    struct NodeSummary
+    {
+        typename augment_t::Summary value{augment_t::identity()};
+    };
+
+    template<>
+    struct NodeSummary<void>
+    {};
+
+
+    // NOTE : compact node links, node is stored in IndexedStorage and referenced by 32-bit index
+    // links mimic pointers (conversion to NodeT*, ->, assignment from NodeT*) so the tree code stays the same
+    // index is resolved from the address of the link so links live only inside of nodes and can't be copied out
+    template<class NodeT>
+    struct IndexLink
+    {
+        using Storage = IndexedStorage<NodeT>;
+
+        IndexLink() = default;
+        IndexLink(const IndexLink&) = delete;
+
+        IndexLink& operator = (const IndexLink&) = default;
+
+        explicit IndexLink(NodeT* node) : index{Storage::index(node)}
+        {}
+
+        IndexLink& operator = (NodeT* node)
+        {
+            index = Storage::index(node);
+            return *this;
+        }
+
+        operator NodeT* () const
+        {
+            return Storage::pointer(this, index);
+        }
+
+        NodeT* operator -> () const
+        {
+            return Storage::pointer(this, index);
+        }
+
+        u32 index{};
+    };
+
+    // NOTE : parent link and color share one word: parent index takes lower 31 bits, color takes the highest one,
+    // both are members of an anonymous union and only touch their own bits
+    // word is accessed as plain u32 (it is pointer-interconvertible with both structs) so that compiler doesn't
+    // consider accesses through different members as not aliasing
+    inline constexpr const u32 color_bit  = 1u << 31;
+    inline constexpr const u32 index_bits = color_bit - 1;
+
+    struct PackedWord
+    {
+        u32& word()
+        {
+            return *std::launder(reinterpret_cast<u32*>(this));
+        }
+
+        u32 word() const
+        {
+            return *std::launder(reinterpret_cast<const u32*>(this));
+        }
+
+        u32 bits;
+    };
+
+    template<class NodeT>
+    struct ParentLink : PackedWord
+    {
+        using Storage = IndexedStorage<NodeT>;
+
+        ParentLink() = default;
+        ParentLink(const ParentLink&) = delete;
+
+        ParentLink& operator = (NodeT* node)
+        {
+            word() = (word() & color_bit) | Storage::index(node);
+            return *this;
+        }
+
+        ParentLink& operator = (const ParentLink& another)
+        {
+            word() = (word() & color_bit) | (another.word() & index_bits);
+            return *this;
+        }
+
+        operator NodeT* () const
+        {
+            return Storage::pointer(this, word() & index_bits);
+        }
+
+        NodeT* operator -> () const
+        {
+            return Storage::pointer(this, word() & index_bits);
+        }
+    };
+
+    struct ColorBit : PackedWord
+    {
+        ColorBit& operator = (Color color)
+        {
+            word() = (word() & index_bits) | (color == Color::Red ? color_bit : 0u);
+            return *this;
+        }
+
+        ColorBit& operator = (const ColorBit& another)
+        {
+            word() = (word() & index_bits) | (another.word() & color_bit);
+            return *this;
+        }
+
+        operator Color () const
+        {
+            return (word() & color_bit) != 0 ? Color::Red : Color::Black;
+        }
     };
 
 
@@ -24,11 +177,15 @@ namespace trb
     struct TreeNode;
 
     template<class Traits>
-    struct TreeNode<Traits, std::enable_if_t<Traits::threaded>>
+    struct TreeNode<Traits, std::enable_if_t<Traits::threaded && !Traits::indexed>>
     {
         static constexpr bool threaded = true;
+        static constexpr bool counted  = Traits::counted;
+        static constexpr bool indexed  = false;
+        static constexpr bool augmented = !std::is_void_v<typename Traits::Augment>;
 
-        using Key = typename Traits::Key;
+        using Key     = typename Traits::Key;
+        using Augment = typename Traits::Augment;
 
         Key key{};
 
@@ -40,14 +197,22 @@ namespace trb
         TreeNode* next{};
 
         Color color{Color::Black};
+
+        NodeSize<counted> subtree{};
+
+        TRB_NO_UNIQUE_ADDRESS NodeSummary<Augment> summary{};
     };
 
     template<class Traits>
-    struct TreeNode<Traits, std::enable_if_t<!Traits::threaded>>
+    struct TreeNode<Traits, std::enable_if_t<!Traits::threaded && !Traits::indexed>>
     {
         static constexpr bool threaded = false;
+        static constexpr bool counted  = Traits::counted;
+        static constexpr bool indexed  = false;
+        static constexpr bool augmented = !std::is_void_v<typename Traits::Augment>;
 
-        using Key = typename Traits::Key;
+        using Key     = typename Traits::Key;
+        using Augment = typename Traits::Augment;
 
         Key key{};
 
@@ -56,5 +221,65 @@ namespace trb
         TreeNode* right{};
 
         Color color{Color::Black};
+
+        NodeSize<counted> subtree{};
+
+        TRB_NO_UNIQUE_ADDRESS NodeSummary<Augment> summary{};
+    };
+
+    // NOTE : compact nodes, see IndexLink
+    // zero-initialized parent word means nullptr parent and black color
+    // not counted compact nodes have no padding so empty subtree must not take space
+    template<class Traits>
+    struct TreeNode<Traits, std::enable_if_t<Traits::threaded && Traits::indexed>>
+    {
+        static constexpr bool threaded = true;
+        static constexpr bool counted  = Traits::counted;
+        static constexpr bool indexed  = true;
+        static constexpr bool augmented = !std::is_void_v<typename Traits::Augment>;
+
+        using Key     = typename Traits::Key;
+        using Augment = typename Traits::Augment;
+
+        Key key{};
+
+        union
+        {
+            ParentLink<TreeNode> parent;
+            ColorBit color;
+        };
+        IndexLink<TreeNode> left{};
+        IndexLink<TreeNode> right{};
+
+        IndexLink<TreeNode> prev{};
+        IndexLink<TreeNode> next{};
+
+        TRB_NO_UNIQUE_ADDRESS NodeSize<counted> subtree{};
+        TRB_NO_UNIQUE_ADDRESS NodeSummary<Augment> summary{};
+    };
+
+    template<class Traits>
+    struct TreeNode<Traits, std::enable_if_t<!Traits::threaded && Traits::indexed>>
+    {
+        static constexpr bool threaded = false;
+        static constexpr bool counted  = Traits::counted;
+        static constexpr bool indexed  = true;
+        static constexpr bool augmented = !std::is_void_v<typename Traits::Augment>;
+
+        using Key     = typename Traits::Key;
+        using Augment = typename Traits::Augment;
+
+        Key key{};
+
+        union
+        {
+            ParentLink<TreeNode> parent;
+            ColorBit color;
+        };
+        IndexLink<TreeNode> left{};
+        IndexLink<TreeNode> right{};
+
+        TRB_NO_UNIQUE_ADDRESS NodeSize<counted> subtree{};
+        TRB_NO_UNIQUE_ADDRESS NodeSummary<Augment> summary{};
     };
 }
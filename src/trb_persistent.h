@@ -0,0 +1,505 @@
+#pragma once
+
+#include "core.h"
+#include "trb_tree.h"
+#include "pool_storage.h"
+
+#include <vector>
+#include <utility>
+#include <cassert>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+namespace trb
+{
+    // persistent (path-copying) red-black tree: insert & erase don't modify existing version but return a new one,
+    // new version shares all nodes with the old one except copied path so update costs O(log n) time and memory
+    // any version can be queried at any time in O(log n)
+    //
+    // insert is Okasaki's functional insert, erase is Kahrs' functional delete (no parent links, nodes are immutable)
+    // all nodes of all versions live in the arena of the tree and are freed when the tree is destroyed,
+    // nodes of an old version that are not shared with a later one can be released earlier (see retired & release)
+    // NOTE : set semantics (no duplicates)
+    // NOTE : keys are not destructed (arena is freed as a whole) so they must be trivially destructible
+    // NOTE : comparator can have state (sweep-line comparator, for example): each update compares keys with its current state
+    template<class key_t, class compare_t = std::less<key_t>>
+    class PersistentTree
+    {
+    public:
+        using Key     = key_t;
+        using Compare = compare_t;
+
+        static_assert(std::is_trivially_destructible_v<Key>, "Key must be trivially destructible.");
+
+        struct Node
+        {
+            const Node* left{};
+            const Node* right{};
+            Key key{};
+            Color color{};
+            u32 stamp{}; // update that created the node
+        };
+
+        // root of some version, nullptr root is an empty version
+        class Version
+        {
+            friend class PersistentTree;
+
+            Version(const Node* root, u32 size, u32 stamp) : m_root{root}, m_size{size}, m_stamp{stamp}
+            {}
+
+        public:
+            Version() = default;
+
+            u32 size() const
+            {
+                return m_size;
+            }
+
+            bool empty() const
+            {
+                return m_root == nullptr;
+            }
+
+            // NOTE : update that created the version
+            u32 stamp() const
+            {
+                return m_stamp;
+            }
+
+            bool operator == (const Version& another) const
+            {
+                return m_root == another.m_root && m_stamp == another.m_stamp;
+            }
+
+            bool operator != (const Version& another) const
+            {
+                return !(*this == another);
+            }
+
+        private:
+            const Node* m_root{};
+            u32 m_size{};
+            u32 m_stamp{};
+        };
+
+
+    public:
+        PersistentTree(Compare compare = Compare{}) : m_compare(std::move(compare))
+        {}
+
+        PersistentTree(const PersistentTree&) = delete;
+        PersistentTree(PersistentTree&&) noexcept = default;
+
+        ~PersistentTree() = default;
+
+        PersistentTree& operator = (const PersistentTree&) = delete;
+        PersistentTree& operator = (PersistentTree&&) noexcept = default;
+
+
+    private: // node construction
+        const Node* make(const Node* left, const Key& key, const Node* right, Color color)
+        {
+            ++m_nodes;
+            const Node* node = m_arena.alloc(left, right, key, color, m_stamp);
+            m_created.push_back(node);
+            return node;
+        }
+
+        // NOTE : balancing creates intermediate nodes that don't get into the new version, they are released here
+        Version commit(const Node* root, u32 size)
+        {
+            std::vector<const Node*> reachable;
+            created(root, reachable);
+            std::sort(reachable.begin(), reachable.end());
+
+            std::sort(m_created.begin(), m_created.end());
+            for (auto node : m_created)
+                if (!std::binary_search(reachable.begin(), reachable.end(), node))
+                    release(node);
+            m_created.clear();
+
+            return Version{root, size, m_stamp};
+        }
+
+        static bool isRed(const Node* node)
+        {
+            return node != nullptr && node->color == Color::Red;
+        }
+
+        static bool isBlack(const Node* node)
+        {
+            return node != nullptr && node->color == Color::Black;
+        }
+
+        const Node* paint(const Node* node, Color color)
+        {
+            if (node == nullptr || node->color == color)
+                return node;
+            return make(node->left, node->key, node->right, color);
+        }
+
+        // NOTE : resolves red-red violation under black node (a, x, b are the children & key of the node)
+        const Node* balance(const Node* a, const Key& x, const Node* b)
+        {
+            if (isRed(a) && isRed(b))
+                return make(paint(a, Color::Black), x, paint(b, Color::Black), Color::Red);
+
+            if (isRed(a))
+            {
+                if (isRed(a->left))
+                    return make(paint(a->left, Color::Black), a->key, make(a->right, x, b, Color::Black), Color::Red);
+                if (isRed(a->right))
+                    return make(make(a->left, a->key, a->right->left, Color::Black), a->right->key,
+                        make(a->right->right, x, b, Color::Black), Color::Red);
+            }
+            if (isRed(b))
+            {
+                if (isRed(b->right))
+                    return make(make(a, x, b->left, Color::Black), b->key, paint(b->right, Color::Black), Color::Red);
+                if (isRed(b->left))
+                    return make(make(a, x, b->left->left, Color::Black), b->left->key,
+                        make(b->left->right, b->key, b->right, Color::Black), Color::Red);
+            }
+            return make(a, x, b, Color::Black);
+        }
+
+
+    private: // insert
+        // NOTE : key is not in the tree
+        const Node* insert(const Node* node, const Key& key)
+        {
+            if (node == nullptr)
+                return make(nullptr, key, nullptr, Color::Red);
+
+            if (m_compare(key, node->key))
+            {
+                if (node->color == Color::Black)
+                    return balance(insert(node->left, key), node->key, node->right);
+                return make(insert(node->left, key), node->key, node->right, Color::Red);
+            }
+            else
+            {
+                if (node->color == Color::Black)
+                    return balance(node->left, node->key, insert(node->right, key));
+                return make(node->left, node->key, insert(node->right, key), Color::Red);
+            }
+        }
+
+
+    private: // erase
+        // NOTE : left subtree has lost one black node
+        const Node* balanceLeft(const Node* left, const Key& x, const Node* right)
+        {
+            if (isRed(left))
+                return make(paint(left, Color::Black), x, right, Color::Red);
+            if (isBlack(right))
+                return balance(left, x, paint(right, Color::Red));
+
+            assert(isRed(right) && isBlack(right->left));
+
+            return make(make(left, x, right->left->left, Color::Black), right->left->key,
+                balance(right->left->right, right->key, paint(right->right, Color::Red)), Color::Red);
+        }
+
+        // NOTE : right subtree has lost one black node
+        const Node* balanceRight(const Node* left, const Key& x, const Node* right)
+        {
+            if (isRed(right))
+                return make(left, x, paint(right, Color::Black), Color::Red);
+            if (isBlack(left))
+                return balance(paint(left, Color::Red), x, right);
+
+            assert(isRed(left) && isBlack(left->right));
+
+            return make(balance(paint(left->left, Color::Red), left->key, left->right->left), left->right->key,
+                make(left->right->right, x, right, Color::Black), Color::Red);
+        }
+
+        // NOTE : concatenates trees of equal black height, all keys of left precede all keys of right
+        const Node* append(const Node* left, const Node* right)
+        {
+            if (left == nullptr)
+                return right;
+            if (right == nullptr)
+                return left;
+
+            if (isRed(left) && isRed(right))
+            {
+                const Node* middle = append(left->right, right->left);
+                if (isRed(middle))
+                    return make(make(left->left, left->key, middle->left, Color::Red), middle->key,
+                        make(middle->right, right->key, right->right, Color::Red), Color::Red);
+                return make(left->left, left->key, make(middle, right->key, right->right, Color::Red), Color::Red);
+            }
+            if (isBlack(left) && isBlack(right))
+            {
+                const Node* middle = append(left->right, right->left);
+                if (isRed(middle))
+                    return make(make(left->left, left->key, middle->left, Color::Black), middle->key,
+                        make(middle->right, right->key, right->right, Color::Black), Color::Red);
+                return balanceLeft(left->left, left->key, make(middle, right->key, right->right, Color::Black));
+            }
+            if (isRed(right))
+                return make(append(left, right->left), right->key, right->right, Color::Red);
+            return make(left->left, left->key, append(left->right, right), Color::Red);
+        }
+
+        // NOTE : key is in the tree
+        template<class key_u>
+        const Node* erase(const Node* node, const key_u& key)
+        {
+            assert(node != nullptr);
+
+            if (m_compare(key, node->key))
+            {
+                if (isBlack(node->left))
+                    return balanceLeft(erase(node->left, key), node->key, node->right);
+                return make(erase(node->left, key), node->key, node->right, Color::Red);
+            }
+            if (m_compare(node->key, key))
+            {
+                if (isBlack(node->right))
+                    return balanceRight(node->left, node->key, erase(node->right, key));
+                return make(node->left, node->key, erase(node->right, key), Color::Red);
+            }
+            return append(node->left, node->right);
+        }
+
+
+    private: // search
+        template<class key_u>
+        const Node* find(const Node* node, const key_u& key) const
+        {
+            while (node != nullptr)
+            {
+                if (m_compare(key, node->key))
+                    node = node->left;
+                else if (m_compare(node->key, key))
+                    node = node->right;
+                else
+                    break;
+            }
+            return node;
+        }
+
+        template<class key_u>
+        const Node* lowerBound(const Node* node, const key_u& key) const
+        {
+            const Node* lb = nullptr;
+            while (node != nullptr)
+            {
+                if (m_compare(node->key, key))
+                {
+                    node = node->right;
+                }
+                else
+                {
+                    lb = node;
+                    node = node->left;
+                }
+            }
+            return lb;
+        }
+
+        template<class key_u>
+        const Node* upperBound(const Node* node, const key_u& key) const
+        {
+            const Node* ub = nullptr;
+            while (node != nullptr)
+            {
+                if (m_compare(key, node->key))
+                {
+                    ub = node;
+                    node = node->left;
+                }
+                else
+                {
+                    node = node->right;
+                }
+            }
+            return ub;
+        }
+
+        template<class Visitor>
+        static void traverse(const Node* node, Visitor& visitor)
+        {
+            if (node == nullptr)
+                return;
+
+            traverse(node->left, visitor);
+            visitor(node->key);
+            traverse(node->right, visitor);
+        }
+
+        // NOTE : nodes of current that were created before or together with old, they are shared with old
+        // and the nodes created later don't reference anything else from old
+        void shared(const Node* node, u32 stamp, std::vector<const Node*>& result) const
+        {
+            if (node == nullptr)
+                return;
+
+            if (node->stamp <= stamp)
+            {
+                result.push_back(node);
+                return;
+            }
+            shared(node->left, stamp, result);
+            shared(node->right, stamp, result);
+        }
+
+        // NOTE : nodes created by the current update
+        void created(const Node* node, std::vector<const Node*>& result) const
+        {
+            if (node == nullptr || node->stamp != m_stamp)
+                return;
+
+            result.push_back(node);
+            created(node->left, result);
+            created(node->right, result);
+        }
+
+        template<class Visitor>
+        static void retired(const Node* node, const std::vector<const Node*>& shared, Visitor& visitor)
+        {
+            if (node == nullptr || std::binary_search(shared.begin(), shared.end(), node))
+                return;
+
+            // NOTE : children first so that visitor can release the node
+            retired(node->left, shared, visitor);
+            retired(node->right, shared, visitor);
+            visitor(node);
+        }
+
+        // returns black height or -1 if properties are violated
+        i32 invariant(const Node* node, const Node* low, const Node* high) const
+        {
+            if (node == nullptr)
+                return 1;
+
+            if (low != nullptr && !m_compare(low->key, node->key))
+                return -1;
+            if (high != nullptr && !m_compare(node->key, high->key))
+                return -1;
+            if (isRed(node) && (isRed(node->left) || isRed(node->right)))
+                return -1;
+
+            i32 left  = invariant(node->left, low, node);
+            i32 right = invariant(node->right, node, high);
+            if (left < 0 || left != right)
+                return -1;
+            return left + (node->color == Color::Black);
+        }
+
+
+    public:
+        // NOTE : returns the same version if key is already present
+        template<class key_u>
+        Version insert(Version version, key_u&& key)
+        {
+            Key inserted(std::forward<key_u>(key));
+            if (find(version.m_root, inserted) != nullptr)
+                return version;
+            ++m_stamp;
+            return commit(paint(insert(version.m_root, inserted), Color::Black), version.m_size + 1);
+        }
+
+        // NOTE : returns the same version if key is not present
+        template<class key_u>
+        Version erase(Version version, key_u&& key)
+        {
+            auto&& erased = lookup_key<Key, Compare>(std::forward<key_u>(key));
+            if (find(version.m_root, erased) == nullptr)
+                return version;
+            ++m_stamp;
+            return commit(paint(erase(version.m_root, erased), Color::Black), version.m_size - 1);
+        }
+
+        // NOTE : see lookup_key in trb_tree.h
+        // search methods return pointer to the key or nullptr if there is no such key
+        template<class key_u>
+        const Key* find(Version version, key_u&& key) const
+        {
+            const Node* node = find(version.m_root, lookup_key<Key, Compare>(std::forward<key_u>(key)));
+            return node != nullptr ? &node->key : nullptr;
+        }
+
+        template<class key_u>
+        bool contains(Version version, key_u&& key) const
+        {
+            return find(version, std::forward<key_u>(key)) != nullptr;
+        }
+
+        template<class key_u>
+        const Key* lowerBound(Version version, key_u&& key) const
+        {
+            const Node* node = lowerBound(version.m_root, lookup_key<Key, Compare>(std::forward<key_u>(key)));
+            return node != nullptr ? &node->key : nullptr;
+        }
+
+        template<class key_u>
+        const Key* upperBound(Version version, key_u&& key) const
+        {
+            const Node* node = upperBound(version.m_root, lookup_key<Key, Compare>(std::forward<key_u>(key)));
+            return node != nullptr ? &node->key : nullptr;
+        }
+
+        // NOTE : visits keys of the version in order
+        template<class Visitor>
+        void traverse(Version version, Visitor visitor) const
+        {
+            traverse(version.m_root, visitor);
+        }
+
+        // NOTE : visits nodes of old version that are not shared with current version, O(k log k) for k visited nodes
+        // current must be derived from old by updates (no branching from older versions in between)
+        template<class Visitor>
+        void retired(Version old, Version current, Visitor visitor) const
+        {
+            std::vector<const Node*> result;
+            shared(current.m_root, old.m_stamp, result);
+            std::sort(result.begin(), result.end());
+
+            retired(old.m_root, result, visitor);
+        }
+
+        // NOTE : node must not be referenced by any version that is still in use
+        void release(const Node* node)
+        {
+            --m_nodes;
+            m_arena.dealloc(const_cast<Node*>(node));
+        }
+
+        // NOTE : releases nodes of old version that are not shared with current version (see retired),
+        // old version and all versions before it must not be used afterwards
+        void release(Version old, Version current)
+        {
+            retired(old, current, [&] (const Node* node) {release(node);});
+        }
+
+        bool invariant(Version version) const
+        {
+            return !isRed(version.m_root) && invariant(version.m_root, nullptr, nullptr) > 0;
+        }
+
+        // NOTE : count of nodes of all versions that are not released
+        u32 nodes() const
+        {
+            return m_nodes;
+        }
+
+        Compare& compare()
+        {
+            return m_compare;
+        }
+
+
+    private:
+        PoolStorage<Node> m_arena;
+        Compare m_compare;
+        u32 m_nodes{};
+        u32 m_stamp{};
+        std::vector<const Node*> m_created;
+    };
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "trb_tree.h"
+#include "bpt_tree.h"
 
 namespace ds
 {
@@ -15,4 +16,37 @@ namespace ds
 
     template<class key_t, class compare_t = std::less<key_t>, template<class> class allocator_t = trb::DefaultAllocator>
     using ListMultiset = trb::Tree<trb::TreeTraits<key_t, compare_t, allocator_t, true, true>>;
-}
+
+    template<class key_t, class compare_t = std::less<key_t>, template<class> class allocator_t = trb::DefaultAllocator>
+    using RankedSet = trb::Tree<trb::TreeTraits<key_t, compare_t, allocator_t, false, false, true>>;
+
+    template<class key_t, class compare_t = std::less<key_t>, template<class> class allocator_t = trb::DefaultAllocator>
+    using RankedMultiset = trb::Tree<trb::TreeTraits<key_t, compare_t, allocator_t, false, true, true>>;
+
+    // NOTE : every subtree keeps summary of its keys (see trb::NodeSummary), ranked as well
+    template<class key_t, class augment_t, class compare_t = std::less<key_t>, template<class> class allocator_t = trb::DefaultAllocator>
+    using AugmentedSet = trb::Tree<trb::TreeTraits<key_t, compare_t, allocator_t, false, false, true, augment_t>>;
+
+    template<class key_t, class augment_t, class compare_t = std::less<key_t>, template<class> class allocator_t = trb::DefaultAllocator>
+    using AugmentedMultiset = trb::Tree<trb::TreeTraits<key_t, compare_t, allocator_t, false, true, true, augment_t>>;
+
+    // NOTE : compact node layout: 32-bit links into the node array of the tree's own allocator, color packed into parent link
+    template<class key_t, class compare_t = std::less<key_t>>
+    using CompactSet = trb::Tree<trb::TreeTraits<key_t, compare_t, trb::IndexedAllocator, false, false>>;
+
+    template<class key_t, class compare_t = std::less<key_t>>
+    using CompactMultiset = trb::Tree<trb::TreeTraits<key_t, compare_t, trb::IndexedAllocator, false, true>>;
+
+    template<class key_t, class compare_t = std::less<key_t>>
+    using CompactListSet = trb::Tree<trb::TreeTraits<key_t, compare_t, trb::IndexedAllocator, true, false>>;
+
+    template<class key_t, class compare_t = std::less<key_t>>
+    using CompactListMultiset = trb::Tree<trb::TreeTraits<key_t, compare_t, trb::IndexedAllocator, true, true>>;
+
+    // NOTE : B+-tree backend with the same basic interface (no extract, rank or join), iterators are invalidated by any modification
+    template<class key_t, class compare_t = std::less<key_t>, template<class> class allocator_t = trb::DefaultAllocator>
+    using BTreeSet = bpt::Tree<bpt::TreeTraits<key_t, compare_t, allocator_t, false>>;
+
+    template<class key_t, class compare_t = std::less<key_t>, template<class> class allocator_t = trb::DefaultAllocator>
+    using BTreeMultiset = bpt::Tree<bpt::TreeTraits<key_t, compare_t, allocator_t, true>>;
+}
\ No newline at end of file
@@ -2,12 +2,19 @@
 
 #include "core.h"
 #include "trb_set.h"
+#include "trb_persistent.h"
+#include "trb_concurrent.h"
 #include "test_util.h"
 
 #include <set>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include <vector>
 #include <random>
+#include <string>
 #include <numeric>
+#include <iterator>
 #include <cstdlib>
 #include <iostream>
 #include <algorithm>
@@ -43,6 +50,51 @@ void test_set_stress()
     std::cout << std::endl;
 }
 
+namespace
+{
+    template<class SetT>
+    void test_backend_stress(const char* name, std::vector<u32>& keys, std::minstd_rand& gen)
+    {
+        f32 insertTime = 0.0f;
+        f32 findTime = 0.0f;
+        f32 scanTime = 0.0f;
+        f32 eraseTime = 0.0f;
+
+        u64 sum = 0;
+        for (u32 k = 0; k < 5; k++)
+        {
+            shuffle(keys, gen);
+
+            SetT s;
+
+            auto c = clock();
+            for (auto& key : keys)
+                s.insert(key);
+            insertTime += (f32)(clock() - c) / CLOCKS_PER_SEC;
+
+            shuffle(keys, gen);
+
+            c = clock();
+            for (auto& key : keys)
+                sum += *s.find(key);
+            findTime += (f32)(clock() - c) / CLOCKS_PER_SEC;
+
+            c = clock();
+            for (auto& key : s)
+                sum += key;
+            scanTime += (f32)(clock() - c) / CLOCKS_PER_SEC;
+
+            c = clock();
+            for (auto& key : keys)
+                s.erase(key);
+            eraseTime += (f32)(clock() - c) / CLOCKS_PER_SEC;
+        }
+
+        std::cout << name << " elapsed (insert / find / scan / erase): "
+            << insertTime / 5 << " / " << findTime / 5 << " / " << scanTime / 5 << " / " << eraseTime / 5 << " (" << sum << ")" << std::endl;
+    }
+}
+
 void test_my_set_stress()
 {
     std::cout << "************************************" << std::endl;
@@ -56,20 +108,26 @@ void test_my_set_stress()
     //std::minstd_rand gen(device());
     std::minstd_rand gen(12345);
 
+    test_backend_stress<std::set<u32>>("std set", keys, gen);
+    test_backend_stress<Set>("my set", keys, gen);
+    test_backend_stress<ds::BTreeSet<u32>>("b+ tree set", keys, gen);
+
+    std::sort(keys.begin(), keys.end());
     for (u32 k = 0; k < 10; k++)
     {
-        shuffle(keys, gen);
-
         Set s;
 
         auto c = clock();
-        for (auto& key : keys)
-        {
-            s.insert(key);
-        }
+        s.assignSorted(keys.begin(), keys.end());
         c = clock() - c;
 
-        std::cout << "my set elapsed: " << (f32)c / CLOCKS_PER_SEC << std::endl;
+        ds::BTreeSet<u32> b;
+
+        auto d = clock();
+        b.assignSorted(keys.begin(), keys.end());
+        d = clock() - d;
+
+        std::cout << "sorted build elapsed (my set / b+ tree set): " << (f32)c / CLOCKS_PER_SEC << " / " << (f32)d / CLOCKS_PER_SEC << std::endl;
     }
 
     std::cout << std::endl;
@@ -601,3 +659,1011 @@ void test_multiset_order()
 
     std::cout << "Testing finished." << std::endl << std::endl;
 }
+
+
+void test_my_set_order_statistics()
+{
+    std::cout << "**********************************" << std::endl;
+    std::cout << "**** testing order statistics ****" << std::endl;
+    std::cout << "**********************************" << std::endl;
+
+    using RankedSet = ds::RankedSet<u32>;
+
+    std::vector<u32> keys(4096);
+    std::iota(keys.begin(), keys.end(), 0);
+
+    std::random_device device;
+    auto seed = device();
+    std::minstd_rand gen(seed);
+
+    std::cout << "seed: " << seed << std::endl;
+
+    for (i32 k = 0; k < 20; k++)
+    {
+        shuffle(keys, gen);
+
+        RankedSet rs;
+        std::set<u32> s;
+        for (u32 i = 0; i < keys.size() / 2; i++)
+        {
+            rs.insert(keys[i]);
+            s.insert(keys[i]);
+        }
+
+        shuffle(keys, gen);
+        for (u32 i = 0; i < keys.size() / 4; i++)
+        {
+            rs.erase(keys[i]);
+            s.erase(keys[i]);
+        }
+
+        assert(rs.invariant());
+        assert(rs.size() == s.size());
+
+        u32 rank = 0;
+        for (auto it = s.begin(); it != s.end(); ++it, ++rank)
+        {
+            auto sel = rs.select(rank);
+            assert(sel != rs.end() && *sel == *it);
+            assert(rs.rank(sel) == rank);
+            assert(rs.begin() + rank == sel);
+            assert(sel - rs.begin() == rank);
+        }
+        assert(rs.select(rank) == rs.end());
+        assert(rs.rank(rs.end()) == rs.size());
+        assert(rs.end() - 1 == rs.select(rs.size() - 1));
+
+        auto lb = rs.lowerBound(1024u);
+        auto ub = rs.upperBound(3072u);
+        assert(ub - lb == (i64)std::distance(s.lower_bound(1024u), s.upper_bound(3072u)));
+    }
+
+    std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+namespace
+{
+    // commutative summary
+    struct SumAugment
+    {
+        using Summary = u64;
+
+        static Summary identity()
+        {
+            return 0;
+        }
+
+        static Summary lift(u32 key)
+        {
+            return key;
+        }
+
+        static Summary combine(Summary left, Summary right)
+        {
+            return left + right;
+        }
+    };
+
+    // order dependent summary: polynomial hash of the key sequence
+    struct HashAugment
+    {
+        static constexpr const u64 base = 1'000'003;
+
+        struct Summary
+        {
+            u64 hash{};
+            u64 power{1};
+
+            bool operator == (const Summary&) const = default;
+        };
+
+        static Summary identity()
+        {
+            return {};
+        }
+
+        static Summary lift(u32 key)
+        {
+            return {key + 1ull, base};
+        }
+
+        static Summary combine(const Summary& left, const Summary& right)
+        {
+            return {left.hash * right.power + right.hash, left.power * right.power};
+        }
+    };
+}
+
+
+namespace
+{
+    template<class SetT>
+    void test_assign_sorted(const std::vector<u32>& keys)
+    {
+        SetT s(trb::sorted, keys.begin(), keys.end());
+        assert(s.invariant());
+        assert(std::equal(s.begin(), s.end(), keys.begin(), keys.end()));
+
+        // tree must stay valid after ordinary modifications
+        for (u32 i = 0; i < keys.size(); i += 2)
+            s.erase(keys[i]);
+        assert(s.invariant());
+        for (u32 i = 0; i < keys.size(); i += 3)
+            s.insert(keys[i]);
+        assert(s.invariant());
+
+        s.assignSorted(keys.begin(), keys.end());
+        assert(s.invariant());
+    }
+}
+
+void test_my_set_assign_sorted()
+{
+    std::cout << "*********************************" << std::endl;
+    std::cout << "**** testing sorted building ****" << std::endl;
+    std::cout << "*********************************" << std::endl;
+
+    std::vector<u32> keys;
+    for (u32 count = 0; count < 1100; count++)
+    {
+        keys.resize(count);
+        std::iota(keys.begin(), keys.end(), 0);
+
+        test_assign_sorted<ds::Set<u32>>(keys);
+        test_assign_sorted<ds::ListSet<u32>>(keys);
+        test_assign_sorted<ds::RankedSet<u32>>(keys);
+        test_assign_sorted<ds::AugmentedSet<u32, HashAugment>>(keys);
+
+        for (auto& key : keys)
+            key /= 3;
+
+        test_assign_sorted<ds::Multiset<u32>>(keys);
+        test_assign_sorted<ds::ListMultiset<u32>>(keys);
+        test_assign_sorted<ds::RankedMultiset<u32>>(keys);
+        test_assign_sorted<ds::AugmentedMultiset<u32, HashAugment>>(keys);
+    }
+
+    std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+namespace
+{
+    template<class SetT>
+    void test_join_split(std::vector<u32> keys, std::minstd_rand& gen)
+    {
+        std::sort(keys.begin(), keys.end());
+
+        for (u32 k = 0; k < 50; k++)
+        {
+            SetT s(trb::sorted, keys.begin(), keys.end());
+
+            // make tree shape irregular
+            for (u32 i = 0; i < keys.size() / 4; i++)
+            {
+                u32 key = keys[gen() % keys.size()];
+                s.erase(key);
+                s.insert(key);
+            }
+
+            u32 pivot = keys.empty() ? 0u : keys[gen() % keys.size()] + gen() % 3;
+
+            auto right = s.split(pivot);
+            assert(s.invariant());
+            assert(right.invariant());
+
+            auto mid = std::lower_bound(keys.begin(), keys.end(), pivot);
+            assert(std::equal(s.begin(), s.end(), keys.begin(), mid));
+            assert(std::equal(right.begin(), right.end(), mid, keys.end()));
+
+            SetT joined = SetT::join(std::move(s), std::move(right));
+            assert(joined.invariant());
+            assert(s.empty() && right.empty());
+            assert(std::equal(joined.begin(), joined.end(), keys.begin(), keys.end()));
+
+            auto greater = joined.split(pivot);
+            greater.erase(pivot);
+            joined = SetT::join(std::move(joined), pivot, std::move(greater));
+            assert(joined.invariant());
+            assert(joined.contains(pivot));
+        }
+    }
+}
+
+void test_my_set_join_split()
+{
+    std::cout << "********************************" << std::endl;
+    std::cout << "**** testing join and split ****" << std::endl;
+    std::cout << "********************************" << std::endl;
+
+    std::random_device device;
+    auto seed = device();
+    std::minstd_rand gen(seed);
+
+    std::cout << "seed: " << seed << std::endl;
+
+    for (u32 count : {0u, 1u, 2u, 3u, 10u, 100u, 1000u, 10000u})
+    {
+        std::vector<u32> keys(count);
+        for (auto& key : keys)
+            key = gen() % (count * 4 + 1);
+
+        test_join_split<ds::Multiset<u32>>(keys, gen);
+        test_join_split<ds::RankedMultiset<u32>>(keys, gen);
+        test_join_split<ds::AugmentedMultiset<u32, HashAugment>>(keys, gen);
+
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+        test_join_split<ds::Set<u32>>(keys, gen);
+        test_join_split<ds::RankedSet<u32>>(keys, gen);
+        test_join_split<ds::AugmentedSet<u32, HashAugment>>(keys, gen);
+    }
+
+    std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+namespace
+{
+    template<class SetT>
+    void test_set_algebra(std::vector<u32> a, std::vector<u32> b, u32 threads)
+    {
+        std::sort(a.begin(), a.end());
+        std::sort(b.begin(), b.end());
+
+        std::vector<u32> expected;
+
+        auto check = [&] (SetT& result)
+        {
+            assert(result.invariant());
+            assert(std::equal(result.begin(), result.end(), expected.begin(), expected.end()));
+        };
+
+        SetT s(trb::sorted, a.begin(), a.end());
+        s.unite(SetT(trb::sorted, b.begin(), b.end()), threads);
+        std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+        check(s);
+
+        expected.clear();
+        s = SetT(trb::sorted, a.begin(), a.end());
+        s.intersect(SetT(trb::sorted, b.begin(), b.end()), threads);
+        std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+        check(s);
+
+        expected.clear();
+        s = SetT(trb::sorted, a.begin(), a.end());
+        s.subtract(SetT(trb::sorted, b.begin(), b.end()), threads);
+        std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+        check(s);
+    }
+}
+
+void test_my_set_algebra()
+{
+    std::cout << "*****************************" << std::endl;
+    std::cout << "**** testing set algebra ****" << std::endl;
+    std::cout << "*****************************" << std::endl;
+
+    std::random_device device;
+    auto seed = device();
+    std::minstd_rand gen(seed);
+
+    std::cout << "seed: " << seed << std::endl;
+
+    for (u32 countA : {0u, 1u, 10u, 1000u, 100000u})
+    {
+        for (u32 countB : {0u, 1u, 10u, 1000u, 100000u})
+        {
+            for (u32 threads : {1u, 4u})
+            {
+                u32 range = (countA + countB) / 2 + 1;
+
+                std::vector<u32> a(countA);
+                std::vector<u32> b(countB);
+                for (auto& key : a)
+                    key = gen() % range;
+                for (auto& key : b)
+                    key = gen() % range;
+
+                test_set_algebra<ds::Multiset<u32>>(a, b, threads);
+                test_set_algebra<ds::RankedMultiset<u32>>(a, b, threads);
+
+                std::sort(a.begin(), a.end());
+                a.erase(std::unique(a.begin(), a.end()), a.end());
+                std::sort(b.begin(), b.end());
+                b.erase(std::unique(b.begin(), b.end()), b.end());
+
+                test_set_algebra<ds::Set<u32>>(a, b, threads);
+                test_set_algebra<ds::RankedSet<u32>>(a, b, threads);
+            }
+        }
+    }
+
+    std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+namespace
+{
+    template<class SetT, class RefT>
+    void test_compact_random(std::minstd_rand& gen)
+    {
+        SetT s;
+        RefT ref;
+        for (u32 i = 0; i < 20000; i++)
+        {
+            u32 key = gen() % 1000;
+            if (gen() % 3 != 0)
+            {
+                s.insert(key);
+                ref.insert(key);
+            }
+            else
+            {
+                // NOTE : tree erases only one of equal keys
+                s.erase(key);
+                if (auto it = ref.find(key); it != ref.end())
+                    ref.erase(it);
+            }
+        }
+        assert(s.invariant());
+        assert(std::equal(s.begin(), s.end(), ref.begin(), ref.end()));
+    }
+
+    template<class SetT>
+    void test_compact_scan(const char* name, std::vector<u32>& keys)
+    {
+        SetT s;
+
+        auto c = clock();
+        for (auto& key : keys)
+            s.insert(key);
+        c = clock() - c;
+
+        u64 sum = 0;
+        auto d = clock();
+        for (u32 k = 0; k < 10; k++)
+            for (auto& key : s)
+                sum += key;
+        d = clock() - d;
+
+        std::cout << name << " node: " << sizeof(typename SetT::Node) << " bytes, "
+            << "insert elapsed: " << (f32)c / CLOCKS_PER_SEC << ", "
+            << "scan elapsed: " << (f32)d / CLOCKS_PER_SEC << " (" << sum << ")" << std::endl;
+    }
+}
+
+void test_my_set_compact()
+{
+    std::cout << "*****************************" << std::endl;
+    std::cout << "**** testing compact set ****" << std::endl;
+    std::cout << "*****************************" << std::endl;
+
+    static_assert(sizeof(ds::CompactSet<u32>::Node) == 16);
+    static_assert(sizeof(ds::CompactListSet<u32>::Node) == 24);
+
+    std::random_device device;
+    auto seed = device();
+    std::minstd_rand gen(seed);
+
+    std::cout << "seed: " << seed << std::endl;
+
+    for (u32 k = 0; k < 10; k++)
+    {
+        test_compact_random<ds::CompactSet<u32>, std::set<u32>>(gen);
+        test_compact_random<ds::CompactMultiset<u32>, std::multiset<u32>>(gen);
+        test_compact_random<ds::CompactListSet<u32>, std::set<u32>>(gen);
+        test_compact_random<ds::CompactListMultiset<u32>, std::multiset<u32>>(gen);
+    }
+
+    // every tree has its own node array, moved tree keeps its nodes
+    {
+        ds::CompactSet<u32> a;
+        ds::CompactSet<u32> b;
+        for (u32 i = 0; i < 100'000; i++)
+        {
+            a.insert(i);
+            b.insert(2 * i);
+        }
+
+        ds::CompactSet<u32> c(std::move(b));
+        assert(a.invariant() && c.invariant());
+        assert(a.size() == 100'000 && c.size() == 100'000);
+        assert(a.contains(99'999u) && !c.contains(99'999u) && c.contains(199'998u));
+    }
+
+    std::vector<u32> keys(2'000'000);
+    std::iota(keys.begin(), keys.end(), 0);
+    shuffle(keys, gen);
+
+    test_compact_scan<ds::Set<u32>>("set", keys);
+    test_compact_scan<ds::CompactSet<u32>>("compact set", keys);
+    test_compact_scan<ds::ListSet<u32>>("list set", keys);
+    test_compact_scan<ds::CompactListSet<u32>>("compact list set", keys);
+
+    std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+namespace
+{
+    struct TransparentCompare
+    {
+        using is_transparent = void;
+
+        bool operator () (u32 a, u32 b) const
+        {
+            return a < b;
+        }
+
+        bool operator () (u32 a, f64 b) const
+        {
+            return a < b;
+        }
+
+        bool operator () (f64 a, u32 b) const
+        {
+            return a < b;
+        }
+    };
+
+    // NOTE : counts conversions from lookup keys
+    struct Name
+    {
+        Name() = default;
+
+        Name(const char* str) : value{str}
+        {
+            ++conversions;
+        }
+
+        bool operator < (const Name& another) const
+        {
+            return value < another.value;
+        }
+
+        std::string value;
+
+        static inline u32 conversions{};
+    };
+
+    template<class TransparentSetT, class SetT, class NameSetT>
+    void test_lookup()
+    {
+        std::vector<u32> keys(10);
+        std::iota(keys.begin(), keys.end(), 0);
+
+        // transparent comparator gets lookup keys as they are
+        TransparentSetT s(trb::sorted, keys.begin(), keys.end());
+        assert(*s.lowerBound(2.5) == 3);
+        assert(*s.upperBound(2.5) == 3);
+        assert(*s.lowerBound(3.0) == 3);
+        assert(*s.upperBound(3.0) == 4);
+        assert(s.find(2.5) == s.end());
+        assert(*s.find(3.0) == 3);
+        assert(!s.contains(2.5));
+        s.erase(2.5);
+        assert(s.size() == 10);
+
+        // otherwise lookup key is converted to the key type as in std containers
+        SetT t(trb::sorted, keys.begin(), keys.end());
+        assert(*t.lowerBound(2.5) == 2);
+        assert(*t.upperBound(2.5) == 3);
+        assert(t.contains(2.5));
+
+        // and it is converted only once
+        std::vector<Name> names{"a", "b", "c", "d", "e", "f", "g", "h"};
+        NameSetT n(trb::sorted, names.begin(), names.end());
+
+        Name::conversions = 0;
+        assert(n.lowerBound("c")->value == "c");
+        assert(n.upperBound("c")->value == "d");
+        assert(n.find("cc") == n.end());
+        assert(n.contains("h"));
+        assert(Name::conversions == 4);
+    }
+}
+
+void test_my_set_transparent()
+{
+    std::cout << "************************************" << std::endl;
+    std::cout << "**** testing transparent lookup ****" << std::endl;
+    std::cout << "************************************" << std::endl;
+
+    test_lookup<ds::Set<u32, TransparentCompare>, ds::Set<u32>, ds::Set<Name>>();
+    test_lookup<ds::BTreeSet<u32, TransparentCompare>, ds::BTreeSet<u32>, ds::BTreeSet<Name>>();
+
+    std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+namespace
+{
+    template<class SetT, class RefT>
+    void test_hint_random(std::minstd_rand& gen)
+    {
+        SetT s;
+        RefT ref;
+        for (u32 i = 0; i < 20000; i++)
+        {
+            u32 key = gen() % 1000;
+
+            // good hint, hint at the end or arbitrary one
+            auto hint = s.end();
+            if (u32 kind = gen() % 3; kind == 0)
+                hint = s.upperBound(key);
+            else if (kind == 1)
+                hint = s.lowerBound(gen() % 1000);
+
+            auto it = gen() % 2 == 0 ? s.insert(hint, key) : s.emplaceHint(hint, key);
+            assert(*it == key);
+            ref.insert(key);
+
+            // extracted node is reinserted with a hint as well
+            if (gen() % 4 == 0)
+            {
+                auto next = std::next(it);
+                auto reinserted = s.insert(next, s.extract(it));
+                assert(*reinserted == key);
+            }
+        }
+        assert(s.invariant());
+        assert(s.size() == ref.size());
+        assert(std::equal(s.begin(), s.end(), ref.begin(), ref.end()));
+    }
+
+    template<class SetT>
+    void test_hint_sorted(const char* name, const std::vector<u32>& keys)
+    {
+        SetT s0;
+        auto c0 = clock();
+        for (auto& key : keys)
+            s0.insert(key);
+        c0 = clock() - c0;
+
+        SetT s1;
+        auto c1 = clock();
+        for (auto& key : keys)
+            s1.insert(s1.end(), key);
+        c1 = clock() - c1;
+
+        assert(s1.invariant());
+        assert(std::equal(s0.begin(), s0.end(), s1.begin(), s1.end()));
+
+        std::cout << name << " insert elapsed: " << (f32)c0 / CLOCKS_PER_SEC << ", "
+            << "hinted insert elapsed: " << (f32)c1 / CLOCKS_PER_SEC << std::endl;
+    }
+}
+
+void test_my_set_hint()
+{
+    std::cout << "**********************************" << std::endl;
+    std::cout << "**** testing hinted insertion ****" << std::endl;
+    std::cout << "**********************************" << std::endl;
+
+    std::random_device device;
+    auto seed = device();
+    std::minstd_rand gen(seed);
+
+    std::cout << "seed: " << seed << std::endl;
+
+    for (u32 k = 0; k < 10; k++)
+    {
+        test_hint_random<ds::Set<u32>, std::set<u32>>(gen);
+        test_hint_random<ds::Multiset<u32>, std::multiset<u32>>(gen);
+        test_hint_random<ds::ListSet<u32>, std::set<u32>>(gen);
+        test_hint_random<ds::ListMultiset<u32>, std::multiset<u32>>(gen);
+        test_hint_random<ds::RankedSet<u32>, std::set<u32>>(gen);
+        test_hint_random<ds::RankedMultiset<u32>, std::multiset<u32>>(gen);
+        test_hint_random<ds::CompactSet<u32>, std::set<u32>>(gen);
+        test_hint_random<ds::CompactListMultiset<u32>, std::multiset<u32>>(gen);
+    }
+
+    // sorted stream: each key goes right before the end
+    std::vector<u32> keys(2'000'000);
+    std::iota(keys.begin(), keys.end(), 0);
+
+    test_hint_sorted<ds::Set<u32>>("set", keys);
+    test_hint_sorted<ds::ListSet<u32>>("list set", keys);
+    test_hint_sorted<ds::RankedSet<u32>>("ranked set", keys);
+    test_hint_sorted<ds::CompactListSet<u32>>("compact list set", keys);
+
+    std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+void test_my_set_persistent()
+{
+    std::cout << "*********************************" << std::endl;
+    std::cout << "**** testing persistent tree ****" << std::endl;
+    std::cout << "*********************************" << std::endl;
+
+    std::random_device device;
+    auto seed = device();
+    std::minstd_rand gen(seed);
+
+    std::cout << "seed: " << seed << std::endl;
+
+    using Tree = trb::PersistentTree<u32>;
+
+    Tree tree;
+    std::vector<Tree::Version> versions{Tree::Version{}};
+    std::vector<std::set<u32>> snapshots{std::set<u32>{}};
+
+    u32 maxCopied = 0;
+    for (u32 i = 0; i < 5000; i++)
+    {
+        u32 key = gen() % 2000;
+        u32 nodes = tree.nodes();
+
+        // updates are applied to random old versions too
+        u32 base = gen() % 4 == 0 ? gen() % versions.size() : versions.size() - 1;
+
+        auto snapshot = snapshots[base];
+        if (gen() % 3 != 0)
+        {
+            versions.push_back(tree.insert(versions[base], key));
+            snapshot.insert(key);
+        }
+        else
+        {
+            versions.push_back(tree.erase(versions[base], key));
+            snapshot.erase(key);
+        }
+        snapshots.push_back(std::move(snapshot));
+
+        maxCopied = std::max(maxCopied, tree.nodes() - nodes);
+    }
+
+    // update copies O(log n) nodes
+    assert(maxCopied <= 64);
+
+    // every version is intact
+    for (u32 i = 0; i < versions.size(); i++)
+    {
+        auto& version  = versions[i];
+        auto& snapshot = snapshots[i];
+
+        assert(tree.invariant(version));
+        assert(version.size() == snapshot.size());
+
+        std::vector<u32> keys;
+        tree.traverse(version, [&] (u32 key) {keys.push_back(key);});
+        assert(std::equal(keys.begin(), keys.end(), snapshot.begin(), snapshot.end()));
+
+        for (u32 k = 0; k < 10; k++)
+        {
+            u32 key = gen() % 2100;
+
+            auto lb = tree.lowerBound(version, key);
+            auto ub = tree.upperBound(version, key);
+            auto refLb = snapshot.lower_bound(key);
+            auto refUb = snapshot.upper_bound(key);
+            assert(lb == nullptr ? refLb == snapshot.end() : refLb != snapshot.end() && *lb == *refLb);
+            assert(ub == nullptr ? refUb == snapshot.end() : refUb != snapshot.end() && *ub == *refUb);
+            assert(tree.contains(version, key) == (snapshot.count(key) != 0));
+        }
+    }
+
+    std::cout << "versions: " << versions.size() << ", nodes: " << tree.nodes()
+        << ", max copied per update: " << maxCopied << std::endl;
+
+    std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+namespace
+{
+    template<class SetT, class RefT>
+    void test_augmented_random(std::minstd_rand& gen)
+    {
+        using Augment = typename SetT::Node::Augment;
+
+        // summary of [low, high) computed by brute force
+        auto fold = [] (RefT& ref, u32 low, u32 high)
+        {
+            auto summary = Augment::identity();
+            for (auto it = ref.lower_bound(low); it != ref.end() && *it < high; ++it)
+                summary = Augment::combine(summary, Augment::lift(*it));
+            return summary;
+        };
+
+        SetT s;
+        RefT ref;
+        for (u32 i = 0; i < 5000; i++)
+        {
+            u32 key = gen() % 1000;
+            if (gen() % 3 != 0)
+            {
+                s.insert(key);
+                ref.insert(key);
+            }
+            else
+            {
+                // NOTE : tree erases only one of equal keys
+                s.erase(key);
+                if (auto it = ref.find(key); it != ref.end())
+                    ref.erase(it);
+            }
+
+            u32 low  = gen() % 1100;
+            u32 high = gen() % 1100;
+            assert(s.summary(low, high) == fold(ref, low, high));
+        }
+        assert(s.invariant());
+        assert(s.summary() == fold(ref, 0, 1000));
+    }
+}
+
+void test_my_set_augmented()
+{
+    std::cout << "******************************" << std::endl;
+    std::cout << "**** testing augmentation ****" << std::endl;
+    std::cout << "******************************" << std::endl;
+
+    std::random_device device;
+    auto seed = device();
+    std::minstd_rand gen(seed);
+
+    std::cout << "seed: " << seed << std::endl;
+
+    for (u32 k = 0; k < 10; k++)
+    {
+        test_augmented_random<ds::AugmentedSet<u32, SumAugment>, std::set<u32>>(gen);
+        test_augmented_random<ds::AugmentedMultiset<u32, SumAugment>, std::multiset<u32>>(gen);
+        test_augmented_random<ds::AugmentedSet<u32, HashAugment>, std::set<u32>>(gen);
+        test_augmented_random<ds::AugmentedMultiset<u32, HashAugment>, std::multiset<u32>>(gen);
+        test_augmented_random<trb::Tree<trb::TreeTraits<u32, std::less<u32>, trb::DefaultAllocator, true, true, false, HashAugment>>, std::multiset<u32>>(gen);
+        test_augmented_random<trb::Tree<trb::TreeTraits<u32, std::less<u32>, trb::IndexedAllocator, false, false, false, HashAugment>>, std::set<u32>>(gen);
+    }
+
+    std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+namespace
+{
+    // NOTE : writer replaces one key per batch so every snapshot must have exactly count keys
+    f32 test_concurrent_readers(std::minstd_rand& gen, u32 readers, u32 count)
+    {
+        using Tree = trb::ConcurrentTree<u32>;
+
+        Tree tree;
+        std::set<u32> ref;
+        tree.update([&] (Tree::Batch& batch)
+        {
+            for (u32 i = 0; i < count; i++)
+            {
+                batch.insert(i * 2);
+                ref.insert(i * 2);
+            }
+        });
+
+        std::atomic<bool> stop{false};
+        std::atomic<u64> reads{0};
+
+        std::vector<std::thread> threads;
+        for (u32 r = 0; r < readers; r++)
+        {
+            threads.emplace_back([&, seed = gen()] ()
+            {
+                std::minstd_rand gen(seed);
+                while (!stop.load(std::memory_order_relaxed))
+                {
+                    auto reader = tree.read();
+                    assert(reader.size() == count);
+
+                    u32 traversed = 0;
+                    reader.traverse([&] (u32) {++traversed;});
+                    assert(traversed == count);
+
+                    for (u32 i = 0; i < 256; i++)
+                    {
+                        u32 key = gen() % (count * 4);
+
+                        auto lb = reader.lowerBound(key);
+                        assert(lb == nullptr || *lb >= key);
+                    }
+                    reads.fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (u32 i = 0; i < 20000; i++)
+        {
+            u32 erased = *std::next(ref.begin(), gen() % ref.size());
+            u32 inserted = gen() % (count * 4);
+            while (ref.count(inserted) != 0)
+                inserted = gen() % (count * 4);
+
+            // key inserted & erased inside the batch is never seen by readers
+            tree.update([&] (Tree::Batch& batch)
+            {
+                batch.erase(erased);
+                batch.insert(count * 4 + inserted);
+                batch.insert(inserted);
+                batch.erase(count * 4 + inserted);
+            });
+            ref.erase(erased);
+            ref.insert(inserted);
+        }
+        stop.store(true);
+        for (auto& thread : threads)
+            thread.join();
+        f32 elapsed = std::chrono::duration<f32>(std::chrono::steady_clock::now() - start).count();
+
+        // no readers left so everything retired is freed
+        tree.reclaim();
+        assert(tree.nodes() == count);
+
+        auto reader = tree.read();
+        assert(reader.invariant());
+
+        std::vector<u32> keys;
+        reader.traverse([&] (u32 key) {keys.push_back(key);});
+        assert(std::equal(keys.begin(), keys.end(), ref.begin(), ref.end()));
+
+        return reads.load() / elapsed;
+    }
+}
+
+void test_my_set_concurrent()
+{
+    std::cout << "************************************" << std::endl;
+    std::cout << "**** testing concurrent readers ****" << std::endl;
+    std::cout << "************************************" << std::endl;
+
+    std::random_device device;
+    auto seed = device();
+    std::minstd_rand gen(seed);
+
+    std::cout << "seed: " << seed << std::endl;
+
+    for (u32 readers : {1, 2, 4})
+    {
+        f32 rate = test_concurrent_readers(gen, readers, 1000);
+
+        std::cout << "readers: " << readers << ", snapshots per second: " << rate << std::endl;
+    }
+
+    std::cout << "testing ended" << std::endl << std::endl;
+}
+
+
+namespace
+{
+    // keys of one group are equal, order inside a group is arbitrary
+    constexpr const u32 group_size = 10'000;
+
+    struct GroupCompare
+    {
+        bool operator () (u32 k0, u32 k1) const
+        {
+            return k0 / group_size < k1 / group_size;
+        }
+    };
+
+    template<class SetT>
+    void test_reverse_random(std::minstd_rand& gen)
+    {
+        SetT s;
+        for (u32 i = 0; i < 2000; i++)
+        {
+            u32 key = gen() % 50 * group_size + i;
+            s.insert(key);
+        }
+
+        for (u32 i = 0; i < 200; i++)
+        {
+            u32 group = gen() % 52 * group_size;
+
+            auto first = s.lowerBound(group);
+            auto last  = s.upperBound(group);
+
+            // random subrange of the group
+            std::vector<const u32*> keys;
+            for (auto it = first; it != last; ++it)
+                keys.push_back(&*it);
+            if (!keys.empty() && gen() % 2 == 0)
+            {
+                u32 skip = gen() % keys.size();
+                for (u32 k = 0; k < skip; k++)
+                    ++first;
+                keys.erase(keys.begin(), keys.begin() + skip);
+            }
+            if (!keys.empty() && gen() % 2 == 0)
+            {
+                u32 skip = gen() % keys.size();
+                for (u32 k = 0; k < skip; k++)
+                    --last;
+                keys.erase(keys.end() - skip, keys.end());
+            }
+            std::vector<u32> expected;
+            for (auto key : keys)
+                expected.push_back(*key);
+
+            first = s.reverseRange(first, last);
+            assert(s.invariant());
+
+            // keys stay in their nodes
+            std::reverse(keys.begin(), keys.end());
+            std::reverse(expected.begin(), expected.end());
+            for (u32 k = 0; k < keys.size(); k++, ++first)
+            {
+                assert(&*first == keys[k]);
+                assert(*first == expected[k]);
+            }
+            assert(first == last);
+        }
+    }
+
+    template<class SetT>
+    void test_reverse_bundles(const char* name, u32 groups, u32 count)
+    {
+        SetT s0;
+        SetT s1;
+        for (u32 i = 0; i < groups * count; i++)
+        {
+            s0.insert(i % groups * group_size + i);
+            s1.insert(i % groups * group_size + i);
+        }
+
+        auto c0 = clock();
+        for (u32 group = 0; group < groups; group++)
+        {
+            std::vector<typename SetT::Extract> extracted;
+
+            auto first = s0.lowerBound(group * group_size);
+            auto last  = s0.upperBound(group * group_size);
+            while (first != last)
+                extracted.push_back(s0.extract(first++));
+
+            for (auto it = extracted.rbegin(); it != extracted.rend(); ++it)
+                s0.insert(last, std::move(*it));
+        }
+        c0 = clock() - c0;
+
+        auto c1 = clock();
+        for (u32 group = 0; group < groups; group++)
+            s1.reverseRange(s1.lowerBound(group * group_size), s1.upperBound(group * group_size));
+        c1 = clock() - c1;
+
+        assert(s1.invariant());
+        assert(std::equal(s0.begin(), s0.end(), s1.begin(), s1.end()));
+
+        std::cout << name << " extract & insert elapsed: " << (f32)c0 / CLOCKS_PER_SEC << ", "
+            << "reverse elapsed: " << (f32)c1 / CLOCKS_PER_SEC << std::endl;
+    }
+}
+
+void test_my_set_reverse()
+{
+    std::cout << "********************************" << std::endl;
+    std::cout << "**** testing range reversal ****" << std::endl;
+    std::cout << "********************************" << std::endl;
+
+    std::random_device device;
+    auto seed = device();
+    std::minstd_rand gen(seed);
+
+    std::cout << "seed: " << seed << std::endl;
+
+    for (u32 k = 0; k < 10; k++)
+    {
+        test_reverse_random<trb::Tree<trb::TreeTraits<u32, GroupCompare, trb::DefaultAllocator, false, true, false>>>(gen);
+        test_reverse_random<trb::Tree<trb::TreeTraits<u32, GroupCompare, trb::DefaultAllocator, true, true, false>>>(gen);
+        test_reverse_random<trb::Tree<trb::TreeTraits<u32, GroupCompare, trb::DefaultAllocator, false, true, true>>>(gen);
+        test_reverse_random<trb::Tree<trb::TreeTraits<u32, GroupCompare, trb::IndexedAllocator, true, true, true>>>(gen);
+        test_reverse_random<trb::Tree<trb::TreeTraits<u32, GroupCompare, trb::IndexedAllocator, false, true, false, HashAugment>>>(gen);
+        test_reverse_random<trb::Tree<trb::TreeTraits<u32, GroupCompare, trb::DefaultAllocator, true, true, true, HashAugment>>>(gen);
+    }
+
+    // sweep-line-like bundles
+    test_reverse_bundles<trb::Tree<trb::TreeTraits<u32, GroupCompare, trb::DefaultAllocator, false, true, true>>>("counted", 20'000, 8);
+    test_reverse_bundles<trb::Tree<trb::TreeTraits<u32, GroupCompare, trb::DefaultAllocator, true, true, false>>>("threaded", 20'000, 8);
+
+    std::cout << "testing ended" << std::endl << std::endl;
+}
@@ -29,3 +29,26 @@ void test_my_set_iteration();
 
 
 void test_multiset_order();
+
+
+void test_my_set_order_statistics();
+
+void test_my_set_assign_sorted();
+
+void test_my_set_join_split();
+
+void test_my_set_algebra();
+
+void test_my_set_compact();
+
+void test_my_set_transparent();
+
+void test_my_set_hint();
+
+void test_my_set_persistent();
+
+void test_my_set_augmented();
+
+void test_my_set_concurrent();
+
+void test_my_set_reverse();
@@ -2,13 +2,52 @@
 
 #include "core.h"
 #include "trb_node.h"
+#include "trb_util.h"
+#include "trb_algebra.h"
 
 #include <memory>
+#include <utility>
 #include <cassert>
+#include <iterator>
+#include <functional>
 #include <type_traits>
 
 namespace trb
 {
+    // allocator can optionally provide reserve(count) so that next count nodes are placed in one block
+    template<class Alloc, class = void>
+    struct HasReserve : std::false_type
+    {};
+
+    template<class Alloc>
+    struct HasReserve<Alloc, std::void_t<decltype(std::declval<Alloc&>().reserve(0u))>> : std::true_type
+    {};
+
+    // comparator that declares is_transparent can compare keys with other types directly (as in std containers)
+    template<class Compare, class = void>
+    struct IsTransparent : std::false_type
+    {};
+
+    template<class Compare>
+    struct IsTransparent<Compare, std::void_t<typename Compare::is_transparent>> : std::true_type
+    {};
+
+    // NOTE : transparent comparator gets lookup key as it is, otherwise key is converted to Key once before the search
+    template<class Key, class Compare, class key_t>
+    decltype(auto) lookup_key(key_t&& key)
+    {
+        if constexpr(IsTransparent<Compare>::value || std::is_same_v<std::remove_cv_t<std::remove_reference_t<key_t>>, Key>)
+            return std::forward<key_t>(key);
+        else
+            return Key(std::forward<key_t>(key));
+    }
+
+    // tag for constructors that take already sorted range
+    struct SortedTag
+    {};
+
+    inline constexpr SortedTag sorted{};
+
     template<class T>
     class DefaultAllocator
     {
@@ -28,20 +67,53 @@ namespace trb
         }
     };
 
+    // NOTE : nodes are placed in the node array of the allocator and reference each other by 32-bit indices
+    // (see IndexedStorage & IndexLink), tree with this allocator gets compact node layout
+    // every tree has its own node array so nodes can't be passed between trees (tree is not joinable)
+    template<class T>
+    class IndexedAllocator
+    {
+    public:
+        template<class ... Args>
+        T* alloc(Args&& ... args)
+        {
+            return m_storage.alloc(std::forward<Args>(args)...);
+        }
+
+        void dealloc(T* ptr)
+        {
+            m_storage.dealloc(ptr);
+        }
+
+    private:
+        IndexedStorage<T> m_storage;
+    };
+
+    template<template<class> class allocator_t>
+    inline constexpr bool is_indexed_allocator_v = false;
+
+    template<>
+    inline constexpr bool is_indexed_allocator_v<IndexedAllocator> = true;
+
     // TODO : const iterator    
     // TODO : copy
     // TODO : extended tree (move there insertAfter, insertBefore, etc..)
-    template<class key_t, class compare_t, template<class> class allocator_t, bool threaded_v, bool multi_v>
+    // NOTE : counted tree maintains subtree sizes: rank, select and iterator arithmetic become O(log n)
+    // augmented tree maintains summary of every subtree (see NodeSummary): summary of a key range becomes O(log n)
+    template<class key_t, class compare_t, template<class> class allocator_t, bool threaded_v, bool multi_v, bool counted_v = false, class augment_t = void>
     struct TreeTraits
     {
         static constexpr const bool threaded = threaded_v;
         static constexpr const bool multi = multi_v;
+        static constexpr const bool counted = counted_v;
+        static constexpr const bool augmented = !std::is_void_v<augment_t>;
 
-        using NodeTraits = NodeTraits<key_t, threaded_v>;
+        using NodeTraits = trb::NodeTraits<key_t, threaded_v, counted_v, is_indexed_allocator_v<allocator_t>, augment_t>;
         using Node       = TreeNode<NodeTraits>;
         using Key        = key_t;
         using Compare    = compare_t;
         using Allocator  = allocator_t<Node>;
+        using Augment    = augment_t;
     };
 
     template<class tree_traits_t>
@@ -126,6 +198,14 @@ namespace trb
 
             Iterator operator + (difference_type diff) const
             {
+                if constexpr(tree_traits_t::counted)
+                {
+                    difference_type rank = (difference_type)m_tree->rank(m_node) + diff;
+                    if (rank < 0)
+                        return Iterator{m_tree, m_tree->m_nil};
+                    return Iterator{m_tree, m_tree->select(m_tree->m_root, (u32)rank)};
+                }
+
                 auto it{*this};
                 if (diff > 0)
                 {
@@ -151,6 +231,25 @@ namespace trb
                 return *this + -diff;    
             }
 
+            // NOTE : it must precede this iterator if tree is not counted
+            difference_type operator - (Iterator it) const
+            {
+                if constexpr(tree_traits_t::counted)
+                {
+                    return (difference_type)m_tree->rank(m_node) - (difference_type)m_tree->rank(it.m_node);
+                }
+                else
+                {
+                    difference_type diff = 0;
+                    while (it.m_node != m_node)
+                    {
+                        ++it;
+                        ++diff;
+                    }
+                    return diff;
+                }
+            }
+
 
             bool operator == (Iterator it) const
             {
@@ -203,13 +302,34 @@ namespace trb
             init();
         }
 
+        // NOTE : see assignSorted
+        template<class It>
+        Tree(SortedTag, It first, It last)
+        {
+            init();
+            assignSorted(first, last);
+        }
+
+        // NOTE : see assignSorted
+        template<class It, class Comp = Compare, class Alloc = Allocator>
+        Tree(SortedTag, It first, It last, Comp&& comp, Alloc&& alloc)
+            : m_compare(std::forward<Comp>(comp))
+            , m_allocator(std::forward<Alloc>(alloc))
+        {
+            init();
+            assignSorted(first, last);
+        }
+
 
+        // NOTE : moved-from tree with shared nil stays valid and empty, moved-from tree that owns nil can only be destroyed or assigned
         Tree(Tree&& another) noexcept(std::is_nothrow_move_constructible_v<Compare> && std::is_nothrow_move_constructible_v<Allocator>)
-            : m_root(std::exchange(another.m_root, nullptr))
-            , m_nil(std::exchange(another.m_nil, nullptr))
+            : m_nil(another.m_nil)
+            , m_root(another.m_root)
             , m_compare(std::move(another.m_compare))
             , m_allocator(std::move(another.m_allocator))
-        {}
+        {
+            another.release();
+        }
 
         // NOTE : simplification, see TODO
         Tree(const Tree&) = delete;
@@ -226,11 +346,13 @@ namespace trb
             {
                 deinit();
 
-                m_root = std::exchange(another.m_root, nullptr);
-                m_nil = std::exchange(another.m_nil, nullptr);
+                m_nil  = another.m_nil;
+                m_root = another.m_root;
 
                 m_compare   = std::move(another.m_compare);
                 m_allocator = std::move(another.m_allocator);
+
+                another.release();
             }
             return *this;
         }
@@ -239,22 +361,77 @@ namespace trb
         Tree& operator = (const Tree&) = delete;
 
     private: // m_root & m_nil init
+        // NOTE : not threaded trees of the same type share one nil so that nodes can be passed between them (see join & split)
+        // shared nil is never written to after initialization
+        static Node* sharedNil()
+        {
+            struct Nil
+            {
+                Nil()
+                {
+                    node.left   = &node;
+                    node.right  = &node;
+                    node.parent = &node;
+                    node.color  = trb::Color::Black;
+                }
+
+                Node node{};
+            };
+
+            static Nil nil;
+            return &nil.node;
+        }
+
+        // NOTE : nil of threaded tree is also the head of the list,
+        // indexed nodes can reference only nodes from the node array of the tree
+        static constexpr bool owns_nil = Node::threaded || Node::indexed;
+
         void init()
         {
-            m_nil = m_allocator.alloc();
-            m_nil->left   = m_nil;
-            m_nil->right  = m_nil;
-            m_nil->parent = m_nil;
-            m_nil->color = trb::Color::Black;
+            if constexpr(owns_nil)
+            {
+                m_nil = m_allocator.alloc();
+                m_nil->left   = m_nil;
+                m_nil->right  = m_nil;
+                m_nil->parent = m_nil;
+                m_nil->color = trb::Color::Black;
+                if constexpr(Node::threaded)
+                {
+                    m_nil->prev = m_nil;
+                    m_nil->next = m_nil;
+                }
+            }
+            else
+            {
+                m_nil = sharedNil();
+            }
 
             m_root = m_nil;
         }
 
         void deinit()
         {
+            if (m_nil == nullptr) // moved-from
+                return;
+
             clear();
 
-            m_allocator.dealloc(m_nil);
+            if constexpr(owns_nil)
+                m_allocator.dealloc(m_nil);
+        }
+
+        // NOTE : forgets all nodes, they must be owned by another tree
+        void release()
+        {
+            if constexpr(owns_nil)
+            {
+                m_nil  = nullptr;
+                m_root = nullptr;
+            }
+            else
+            {
+                m_root = m_nil;
+            }
         }
 
 
@@ -373,13 +550,91 @@ namespace trb
             return count;
         }
 
+        // NOTE : node != m_nil, recomputes size and summary of the subtree from the children
+        void updateSubtree(Node* node)
+        {
+            if constexpr(tree_traits_t::counted)
+            {
+                assert(node != m_nil);
+
+                node->subtree.size = node->left->subtree.size + node->right->subtree.size + 1;
+            }
+            if constexpr(tree_traits_t::augmented)
+            {
+                assert(node != m_nil);
+
+                using Augment = typename tree_traits_t::Augment;
+
+                node->summary.value = Augment::combine(
+                    Augment::combine(node->left->summary.value, Augment::lift(node->key)), node->right->summary.value
+                );
+            }
+        }
+
+        // NOTE : recomputes sizes and summaries from node up to the root, node can be m_nil
+        void updatePath(Node* node)
+        {
+            if constexpr(tree_traits_t::counted || tree_traits_t::augmented)
+            {
+                while (node != m_nil)
+                {
+                    updateSubtree(node);
+
+                    node = node->parent;
+                }
+            }
+        }
+
+        // NOTE : count of nodes preceding node, rank of m_nil is size of the tree
+        u32 rank(Node* node)
+        {
+            static_assert(tree_traits_t::counted, "Tree must be counted.");
+
+            if (node == m_nil)
+                return m_root->subtree.size;
+
+            u32 r = node->left->subtree.size;
+            while (node->parent != m_nil)
+            {
+                if (node == node->parent->right)
+                    r += node->parent->left->subtree.size + 1;
+                node = node->parent;
+            }
+            return r;
+        }
+
+        // NOTE : k-th node (zero-based) of the subtree or m_nil if k is out of range
+        Node* select(Node* node, u32 k)
+        {
+            static_assert(tree_traits_t::counted, "Tree must be counted.");
+
+            while (node != m_nil)
+            {
+                u32 left = node->left->subtree.size;
+                if (k < left)
+                {
+                    node = node->left;
+                }
+                else if (k > left)
+                {
+                    k -= left + 1;
+                    node = node->right;
+                }
+                else
+                {
+                    break;
+                }
+            }
+            return node;
+        }
+
         // NOTE : node != m_nil, node->right != m_nil
         void rotateLeft(Node* node)
         {
             assert(node != m_nil);
             assert(node->right != m_nil);
 
-            auto pivot = node->right;
+            Node* pivot = node->right;
 
             node->right = pivot->left;
 
@@ -401,6 +656,9 @@ namespace trb
 
             pivot->parent = node->parent;
             node->parent = pivot;
+
+            take_subtree<Node>(pivot, node);
+            updateSubtree(node);
         }
 
         // NOTE : node != m_nil, node->left != nullptr
@@ -409,7 +667,7 @@ namespace trb
             assert(node != m_nil);
             assert(node->left != m_nil);
 
-            auto pivot = node->left;
+            Node* pivot = node->left;
 
             node->left = pivot->right;
             pivot->right = node;
@@ -430,9 +688,50 @@ namespace trb
 
             pivot->parent = node->parent;
             node->parent = pivot;
+
+            take_subtree<Node>(pivot, node);
+            updateSubtree(node);
         }
 
 
+        // NOTE : builds balanced subtree of count nodes consuming keys from it in order
+        // nodes are allocated in key order, nodes on redDepth level are red, all other are black
+        // last is the previously built node, it is used to thread the list
+        template<class It>
+        Node* buildSorted(It& it, u32 count, u32 depth, u32 redDepth, Node* parent, Node*& last)
+        {
+            if (count == 0)
+                return m_nil;
+
+            u32 leftCount = (count - 1) / 2;
+
+            Node* left = buildSorted(it, leftCount, depth + 1, redDepth, m_nil, last);
+
+            Node* node = m_allocator.alloc(*it);
+            ++it;
+
+            assert(last == m_nil || (tree_traits_t::multi ? !m_compare(node->key, last->key) : m_compare(last->key, node->key)));
+
+            node->parent = parent;
+            node->left   = left;
+            node->color  = depth == redDepth ? Color::Red : Color::Black;
+            if (left != m_nil)
+                left->parent = node;
+
+            if constexpr(Node::threaded)
+            {
+                node->prev = last;
+                last->next = node;
+            }
+            last = node;
+
+            node->right = buildSorted(it, count - 1 - leftCount, depth + 1, redDepth, node, last);
+
+            updateSubtree(node);
+
+            return node;
+        }
+
         // NOTE : looks like upper-bound search which is suitable for multiset
         // each elemeent will be inserted after all equal
         template<class key_t>
@@ -540,7 +839,7 @@ namespace trb
             {
                 if (node->parent == node->parent->parent->left)
                 {
-                    auto uncle = node->parent->parent->right;
+                    Node* uncle = node->parent->parent->right;
                     if (uncle->color == Color::Red)
                     {
                         node->parent->color = Color::Black;
@@ -566,7 +865,7 @@ namespace trb
                 }
                 else
                 {
-                    auto uncle = node->parent->parent->left;
+                    Node* uncle = node->parent->parent->left;
                     if (uncle->color == Color::Red)
                     {
                         node->parent->color = Color::Black;
@@ -662,6 +961,8 @@ namespace trb
 
             node->color = Color::Red;
 
+            updatePath(node);
+
             fixInsert(node);
         }
 
@@ -698,6 +999,8 @@ namespace trb
                 after->next = node;
             }
 
+            updatePath(node);
+
             fixInsert(node);
         }
 
@@ -734,9 +1037,76 @@ namespace trb
                 before->prev = node;
             }
 
+            updatePath(node);
+
             fixInsert(node);
         }
 
+        // NOTE : checks if key can be placed right before hint (hint can be nil - end of the tree), O(1) comparisons
+        // returns predecessor of hint and true if it can, equal node and false if key is already present(not multiset case),
+        // nullptr if key doesn't belong next to hint
+        template<class key_t>
+        std::pair<Node*, bool> searchInsertHint(Node* hint, const key_t& key)
+        {
+            if (m_root == m_nil)
+                return {m_nil, true};
+
+            Node* pred = predecessor(hint);
+            if constexpr(tree_traits_t::multi) // multiset
+            {
+                // pred->key <= key <= hint->key, equal keys are inserted right before hint
+                if ((pred == m_nil || !m_compare(key, pred->key)) && (hint == m_nil || !m_compare(hint->key, key)))
+                    return {pred, true};
+                return {nullptr, true};
+            }
+            else // not multiset
+            {
+                // pred->key < key < hint->key
+                bool afterPred  = pred == m_nil || m_compare(pred->key, key);
+                bool beforeHint = hint == m_nil || m_compare(key, hint->key);
+                if (afterPred && beforeHint)
+                    return {pred, true};
+                if (!afterPred && !m_compare(key, pred->key))
+                    return {pred, false};
+                if (!beforeHint && afterPred && !m_compare(hint->key, key))
+                    return {hint, false};
+                return {nullptr, true};
+            }
+        }
+
+        // NOTE : links node between pred and hint (pred == predecessor(hint)), no comparisons are made
+        // either hint has no left child or pred has no right child so node becomes a leaf right away
+        void insertHint(Node* hint, Node* pred, Node* node)
+        {
+            if (hint == m_nil && pred == m_nil)
+                insert(m_nil, node);
+            else if (hint != m_nil && hint->left == m_nil)
+                insertBefore(hint, node);
+            else
+                insertAfter(pred, node);
+        }
+
+        // NOTE : node != m_nil, node is not in the tree, node is deallocated if equal key is already present(not multiset case)
+        // returns node that holds the key
+        Node* insertHint(Node* hint, Node* node)
+        {
+            auto [insertPos, canInsert] = searchInsertHint(hint, node->key);
+            if (insertPos != nullptr && canInsert)
+            {
+                insertHint(hint, insertPos, node);
+                return node;
+            }
+            if (insertPos == nullptr)
+                std::tie(insertPos, canInsert) = searchInsert(m_root, node->key);
+            if (canInsert)
+            {
+                insert(insertPos, node);
+                return node;
+            }
+            m_allocator.dealloc(node);
+            return insertPos;
+        }
+
 
         void transplant(Node* node, Node* trans)
         {
@@ -751,31 +1121,159 @@ namespace trb
             {
                 m_root = trans;
             }
-            trans->parent = node->parent;
+            if (trans != m_nil)
+                trans->parent = node->parent;
         }
 
-        void fixRemove(Node* restore)
+        // NOTE : n0 != m_nil, n1 != m_nil, nodes exchange their places in the tree (links, color, subtree size),
+        // keys stay in their nodes so iterators follow keys, O(1) (O(log n) for augmented tree)
+        // NOTE : method makes no assumption on the order of the elements: it is your responsability to maintain it
+        void swapNodes(Node* n0, Node* n1)
+        {
+            assert(n0 != m_nil);
+            assert(n1 != m_nil);
+
+            if (n0 == n1)
+                return;
+
+            // n1 can be a child of n0 but not vice versa
+            if (n0->parent == n1)
+                std::swap(n0, n1);
+
+            auto link = [&] (Node* parent, bool left, Node* node)
+            {
+                if (parent == m_nil)
+                    m_root = node;
+                else if (left)
+                    parent->left = node;
+                else
+                    parent->right = node;
+            };
+
+            Node* parent0 = n0->parent;
+            Node* left0   = n0->left;
+            Node* right0  = n0->right;
+            Node* parent1 = n1->parent;
+            Node* left1   = n1->left;
+            Node* right1  = n1->right;
+            bool isLeft0 = parent0 != m_nil && parent0->left == n0;
+            bool isLeft1 = parent1 != m_nil && parent1->left == n1;
+
+            link(parent0, isLeft0, n1);
+            n1->parent = parent0;
+            if (parent1 == n0)
+            {
+                n0->parent = n1;
+                if (isLeft1)
+                {
+                    n1->left  = n0;
+                    n1->right = right0;
+                    if (right0 != m_nil)
+                        right0->parent = n1;
+                }
+                else
+                {
+                    n1->left  = left0;
+                    n1->right = n0;
+                    if (left0 != m_nil)
+                        left0->parent = n1;
+                }
+            }
+            else
+            {
+                link(parent1, isLeft1, n0);
+                n0->parent = parent1;
+
+                n1->left  = left0;
+                n1->right = right0;
+                if (left0 != m_nil)
+                    left0->parent = n1;
+                if (right0 != m_nil)
+                    right0->parent = n1;
+            }
+            n0->left  = left1;
+            n0->right = right1;
+            if (left1 != m_nil)
+                left1->parent = n0;
+            if (right1 != m_nil)
+                right1->parent = n0;
+
+            Color color = n0->color;
+            n0->color = n1->color;
+            n1->color = color;
+
+            if constexpr(Node::threaded)
+            {
+                Node* prev0 = n0->prev;
+                Node* next0 = n0->next;
+                Node* prev1 = n1->prev;
+                Node* next1 = n1->next;
+                if (next0 == n1)
+                {
+                    prev0->next = n1;
+                    n1->prev = prev0;
+                    n1->next = n0;
+                    n0->prev = n1;
+                    n0->next = next1;
+                    next1->prev = n0;
+                }
+                else if (next1 == n0)
+                {
+                    prev1->next = n0;
+                    n0->prev = prev1;
+                    n0->next = n1;
+                    n1->prev = n0;
+                    n1->next = next0;
+                    next0->prev = n1;
+                }
+                else
+                {
+                    prev0->next = n1;
+                    n1->prev = prev0;
+                    n1->next = next0;
+                    next0->prev = n1;
+                    prev1->next = n0;
+                    n0->prev = prev1;
+                    n0->next = next1;
+                    next1->prev = n0;
+                }
+            }
+
+            if constexpr(tree_traits_t::counted)
+                std::swap(n0->subtree.size, n1->subtree.size);
+
+            // order of keys has changed on both paths
+            if constexpr(tree_traits_t::augmented)
+            {
+                updatePath(n0);
+                updatePath(n1);
+            }
+        }
+
+        // NOTE : parent of restore is passed explicitly (restore can be m_nil), m_nil is never written to
+        void fixRemove(Node* restore, Node* parent)
         {
             while (restore != m_root && restore->color == Color::Black)
             {
-                if (restore == restore->parent->left)
+                if (restore == parent->left)
                 {
-                    auto brother = restore->parent->right;
+                    Node* brother = parent->right;
                     if (brother->color == Color::Red)
                     {
                         brother->color = Color::Black;
-                        restore->parent->color = Color::Red;
+                        parent->color = Color::Red;
 
-                        rotateLeft(restore->parent);
+                        rotateLeft(parent);
 
-                        brother = restore->parent->right;
+                        brother = parent->right;
                     }
 
                     if (brother->left->color == Color::Black && brother->right->color == Color::Black)
                     {
                         brother->color = Color::Red;
 
-                        restore = restore->parent;
+                        restore = parent;
+                        parent = restore->parent;
                     }
                     else
                     {
@@ -786,36 +1284,37 @@ namespace trb
 
                             rotateRight(brother);
 
-                            brother = restore->parent->right;
+                            brother = parent->right;
                         }
 
-                        brother->color = restore->parent->color;
-                        restore->parent->color = Color::Black;
+                        brother->color = parent->color;
+                        parent->color = Color::Black;
                         brother->right->color = Color::Black;
 
-                        rotateLeft(restore->parent);
+                        rotateLeft(parent);
 
                         restore = m_root;
                     }
                 }
                 else
                 {
-                    auto brother = restore->parent->left;
+                    Node* brother = parent->left;
                     if (brother->color == Color::Red)
                     {
                         brother->color = Color::Black;
-                        restore->parent->color = Color::Red;
+                        parent->color = Color::Red;
 
-                        rotateRight(restore->parent);
+                        rotateRight(parent);
 
-                        brother = restore->parent->left;
+                        brother = parent->left;
                     }
 
                     if (brother->left->color == Color::Black && brother->right->color == Color::Black)
                     {
                         brother->color = Color::Red;
 
-                        restore = restore->parent;
+                        restore = parent;
+                        parent = restore->parent;
                     }
                     else
                     {
@@ -826,20 +1325,21 @@ namespace trb
 
                             rotateLeft(brother);
 
-                            brother = restore->parent->left;
+                            brother = parent->left;
                         }
 
-                        brother->color = restore->parent->color;
-                        restore->parent->color = Color::Black;
+                        brother->color = parent->color;
+                        parent->color = Color::Black;
                         brother->left->color = Color::Black;
 
-                        rotateRight(restore->parent);
+                        rotateRight(parent);
 
                         restore = m_root;
                     }
                 }
             }
-            restore->color = Color::Black;
+            if (restore != m_nil)
+                restore->color = Color::Black;
         }
 
         void remove(Node* node)
@@ -848,6 +1348,7 @@ namespace trb
 
             Color removed = node->color;
             Node* restore = m_nil;
+            Node* parent  = node->parent;
 
             if (node->left == m_nil)
             {
@@ -871,11 +1372,12 @@ namespace trb
 
                 removed = leftmost->color;
                 restore = leftmost->right;
-                if (restore == m_nil)
-                    restore->parent = leftmost;
+                parent  = leftmost;
 
                 if (node->right != leftmost)
                 {
+                    parent = leftmost->parent;
+
                     transplant(leftmost, leftmost->right);
 
                     leftmost->right = node->right;
@@ -897,9 +1399,11 @@ namespace trb
                 node->next->prev = node->prev;
             }
 
+            // parent is the lowest node whose subtree has changed
+            updatePath(parent);
+
             if (removed == Color::Black)
-                fixRemove(restore);
-            m_nil->parent = m_nil;
+                fixRemove(restore, parent);
         }
 
 
@@ -917,10 +1421,36 @@ namespace trb
             return {Iterator{this, insertPos}, false};
         }
 
+        // NOTE : key is placed right before hint if it belongs there (as std::set::insert with hint does),
+        // otherwise it's inserted as usual. Search is skipped for a good hint so a stream of keys each inserted
+        // next to the previous one costs O(1) amortized: predecessor is O(1) for threaded trees
+        // (not threaded tree walks down to the maximum without comparisons for end() hint), counted tree still updates sizes up to the root
+        // returns iterator to inserted element or to the equal one(not multiset case)
+        template<class key_t>
+        Iterator insert(Iterator hint, key_t&& key)
+        {
+            auto [insertPos, canInsert] = searchInsertHint(hint.m_node, key);
+            if (insertPos == nullptr)
+                return insert(std::forward<key_t>(key)).first;
+            if (!canInsert)
+                return Iterator{this, insertPos};
+
+            Node* node = m_allocator.alloc(std::forward<key_t>(key));
+            insertHint(hint.m_node, insertPos, node);
+            return Iterator{this, node};
+        }
+
+        // NOTE : see insert with hint, key is constructed in advance
+        template<class ... Args>
+        Iterator emplaceHint(Iterator hint, Args&& ... args)
+        {
+            return Iterator{this, insertHint(hint.m_node, m_allocator.alloc(Key(std::forward<Args>(args)...)))};
+        }
+
         template<class key_t>
         void erase(key_t&& key)
         {
-            if (auto node = find(m_root, key); node != m_nil)
+            if (auto node = find(m_root, lookup_key<Key, Compare>(std::forward<key_t>(key))); node != m_nil)
             {
                 remove(node);
 
@@ -940,7 +1470,7 @@ namespace trb
         template<class key_t>
         bool contains(key_t&& key)
         {
-            return find(m_root, std::forward<key_t>(key)) != m_nil;
+            return find(m_root, lookup_key<Key, Compare>(std::forward<key_t>(key))) != m_nil;
         }
 
         void clear()
@@ -955,28 +1485,108 @@ namespace trb
             }
         }
 
+        // NOTE : replaces content of the tree with keys from sorted range in O(n)
+        // range must be sorted according to Compare, for set-like trees keys must be unique
+        template<class It>
+        void assignSorted(It first, It last)
+        {
+            clear();
+
+            auto count = (u32)std::distance(first, last);
+            if (count == 0)
+                return;
+
+            // NOTE : reserved block goes ahead of the nodes freed by clear, so the new tree is contiguous
+            if constexpr(HasReserve<Allocator>::value)
+                m_allocator.reserve(count);
+
+            // depth of the deepest level, its nodes are red (root is always black)
+            u32 redDepth = 0;
+            while ((count >> (redDepth + 1)) != 0)
+                ++redDepth;
+            if (redDepth == 0)
+                redDepth = ~0u;
+
+            Node* prev = m_nil;
+            m_root = buildSorted(first, count, 0, redDepth, m_nil, prev);
+
+            if constexpr(Node::threaded)
+            {
+                prev->next = m_nil;
+                m_nil->prev = prev;
+            }
+        }
+
         bool empty() const
         {
             return m_root == m_nil;
         }
 
+        // NOTE : O(1) for counted tree, O(n) otherwise
+        u32 size()
+        {
+            if constexpr(tree_traits_t::counted)
+            {
+                return m_root->subtree.size;
+            }
+            else
+            {
+                u32 count = 0;
+                for (Node* node = min(m_root); node != m_nil; node = successor(node))
+                    ++count;
+                return count;
+            }
+        }
+
+        // NOTE : counted tree only, rank of end() is size()
+        u32 rank(Iterator it)
+        {
+            return rank(it.m_node);
+        }
+
+        // NOTE : counted tree only, returns end() if k >= size()
+        Iterator select(u32 k)
+        {
+            return Iterator{this, select(m_root, k)};
+        }
+
+        // NOTE : augmented tree only, summary of all keys, O(1)
+        auto summary()
+        {
+            static_assert(tree_traits_t::augmented, "Tree must be augmented.");
+
+            return m_root->summary.value;
+        }
+
+        // NOTE : augmented tree only, summary of keys in [low, high), O(log n)
+        template<class key_t, class key_u>
+        auto summary(key_t&& low, key_u&& high)
+        {
+            static_assert(tree_traits_t::augmented, "Tree must be augmented.");
+
+            return range_summary(m_nil, m_root, m_compare,
+                lookup_key<Key, Compare>(std::forward<key_t>(low)), lookup_key<Key, Compare>(std::forward<key_u>(high))
+            );
+        }
+
 
+        // NOTE : see lookup_key
         template<class key_t>
         Iterator find(key_t&& key)
         {
-            return Iterator{this, find(m_root, std::forward<key_t>(key))};
+            return Iterator{this, find(m_root, lookup_key<Key, Compare>(std::forward<key_t>(key)))};
         }
         
         template<class key_t>
         Iterator lowerBound(key_t&& key)
         {
-            return Iterator{this, lowerBound(m_root, std::forward<key_t>(key))};
+            return Iterator{this, lowerBound(m_root, lookup_key<Key, Compare>(std::forward<key_t>(key)))};
         }
 
         template<class key_t>
         Iterator upperBound(key_t&& key)
         {
-            return Iterator{this, upperBound(m_root, std::forward<key_t>(key))};
+            return Iterator{this, upperBound(m_root, lookup_key<Key, Compare>(std::forward<key_t>(key)))};
         }
 
         Iterator begin()
@@ -1053,6 +1663,17 @@ namespace trb
             return {Iterator{this, insertPos}, false};
         }
 
+        // NOTE : see insert with hint
+        // NOTE : extracted not empty
+        Iterator insert(Iterator hint, Extract&& extracted)
+        {
+            Node* node = extracted.snatch();
+
+            assert(node != nullptr);
+
+            return Iterator{this, insertHint(hint.m_node, node)};
+        }
+
         // NOTE : it != end()
         // NOTE : extracted not empty
         Iterator insertAfter(Iterator it, Extract&& extracted)
@@ -1088,6 +1709,196 @@ namespace trb
             return Extract{this, it.m_node};
         }
 
+        // NOTE : reverses order of keys in [first, last) relinking nodes in place, no keys are moved or compared
+        // so iterators stay valid and follow their keys, returns iterator to the new first key of the range
+        // O(k) for k keys (O(k log n) for augmented tree)
+        // NOTE : method makes no assumption on the order of the elements: it is your responsability to maintain it
+        // (reversed run of equal keys of a multiset, for example)
+        Iterator reverseRange(Iterator first, Iterator last)
+        {
+            if (first == last)
+                return last;
+
+            Node* n0 = first.m_node;
+            Node* n1 = predecessor(last.m_node);
+            Node* result = n1;
+            while (n0 != n1)
+            {
+                Node* next = successor(n0);
+                Node* prev = predecessor(n1);
+
+                swapNodes(n0, n1);
+                if (next == n1)
+                    break;
+
+                n0 = next;
+                n1 = prev;
+            }
+            return Iterator{this, result};
+        }
+
+
+    public: // join & split
+        // NOTE : nodes are passed between trees so join & split are available only for not threaded trees
+        // (they share nil) with stateless allocators (node can be deallocated by any tree)
+        static constexpr bool joinable = !Node::threaded && std::is_empty_v<Allocator>;
+
+        // NOTE : all keys of left must precede key, key must precede all keys of right, O(log n)
+        // result takes comparator and allocator from left, left and right become empty
+        template<class key_t>
+        static Tree join(Tree&& left, key_t&& key, Tree&& right)
+        {
+            static_assert(joinable, "Tree is not joinable.");
+
+            Tree tree(std::move(left));
+
+            Node* node = tree.m_allocator.alloc(std::forward<key_t>(key));
+
+            u32 height{};
+            tree.m_root = trb::join(tree.m_nil, tree.m_root, tree.blackHeight(tree.m_root), node, right.m_root, right.blackHeight(right.m_root), height);
+            right.release();
+
+            return tree;
+        }
+
+        // NOTE : all keys of left must precede all keys of right, O(log n)
+        static Tree join(Tree&& left, Tree&& right)
+        {
+            static_assert(joinable, "Tree is not joinable.");
+
+            Tree tree(std::move(left));
+
+            tree.m_root = trb::join(tree.m_nil, tree.m_root, right.m_root);
+            right.release();
+
+            return tree;
+        }
+
+        // NOTE : keys preceding key stay in the tree, all other keys are moved to the returned tree, O(log n)
+        template<class key_t>
+        Tree split(const key_t& key)
+        {
+            static_assert(joinable, "Tree is not joinable.");
+
+            Tree tree(m_compare, Allocator());
+
+            Node* left{};
+            Node* right{};
+            trb::split(m_nil, m_root, [&] (const Key& nodeKey) {return m_compare(nodeKey, key);}, left, right);
+
+            m_root = left;
+            tree.m_root = right;
+
+            return tree;
+        }
+
+
+    public: // set algebra, see trb_algebra.h
+        // NOTE : another becomes empty, nodes that don't get into the result are deallocated
+        // O(m log(n/m + 1)) work where m is size of the smaller tree, top levels of recursion run on up to threads threads
+        // comparator is copied for each task and called concurrently, allocator must be thread safe
+        void unite(Tree&& another, u32 threads = std::thread::hardware_concurrency())
+        {
+            setOperation<trb::SetOperation::Unite>(std::move(another), threads);
+        }
+
+        void intersect(Tree&& another, u32 threads = std::thread::hardware_concurrency())
+        {
+            setOperation<trb::SetOperation::Intersect>(std::move(another), threads);
+        }
+
+        void subtract(Tree&& another, u32 threads = std::thread::hardware_concurrency())
+        {
+            setOperation<trb::SetOperation::Subtract>(std::move(another), threads);
+        }
+
+    private:
+        template<trb::SetOperation op>
+        void setOperation(Tree&& another, u32 threads)
+        {
+            static_assert(joinable, "Tree is not joinable.");
+
+            assert(this != &another);
+
+            auto dealloc = [] (Node* node) {Allocator().dealloc(node);};
+
+            m_root = trb::set_operation<op>(m_nil, m_root, another.m_root, m_compare, dealloc, trb::parallel_depth(threads));
+            another.release();
+        }
+
+
+    public: // debug
+        // NOTE : checks red-black properties, links, order of keys and augmentation, O(n)
+        bool invariant()
+        {
+            if (m_root->color != Color::Black || m_nil->color != Color::Black)
+                return false;
+            if (m_root != m_nil && m_root->parent != m_nil)
+                return false;
+            if (invariant(m_root) < 0)
+                return false;
+
+            Node* prev = m_nil;
+            for (Node* node = min(m_root); node != m_nil; node = successor(node))
+            {
+                if (prev != m_nil && (tree_traits_t::multi ? m_compare(node->key, prev->key) : !m_compare(prev->key, node->key)))
+                    return false;
+                if constexpr(Node::threaded)
+                {
+                    if (node->prev != prev || prev->next != node)
+                        return false;
+                }
+                prev = node;
+            }
+            if constexpr(Node::threaded)
+            {
+                if (m_nil->prev != prev || prev->next != m_nil)
+                    return false;
+            }
+            return true;
+        }
+
+    private:
+        // returns black height or -1 if subtree is broken
+        i32 invariant(Node* node)
+        {
+            if (node == m_nil)
+                return 0;
+
+            if (node->left != m_nil && node->left->parent != node)
+                return -1;
+            if (node->right != m_nil && node->right->parent != node)
+                return -1;
+            if (node->color == Color::Red && (node->left->color == Color::Red || node->right->color == Color::Red))
+                return -1;
+            if constexpr(tree_traits_t::counted)
+            {
+                if (node->subtree.size != node->left->subtree.size + node->right->subtree.size + 1)
+                    return -1;
+            }
+            if constexpr(tree_traits_t::augmented)
+            {
+                using Augment = typename tree_traits_t::Augment;
+                using Summary = typename Augment::Summary;
+
+                // NOTE : summaries are checked only if they can be compared
+                if constexpr(std::is_invocable_r_v<bool, std::equal_to<>, const Summary&, const Summary&>)
+                {
+                    Summary summary = Augment::combine(
+                        Augment::combine(node->left->summary.value, Augment::lift(node->key)), node->right->summary.value
+                    );
+                    if (!(node->summary.value == summary))
+                        return -1;
+                }
+            }
+
+            i32 left  = invariant(node->left);
+            i32 right = invariant(node->right);
+            if (left < 0 || left != right)
+                return -1;
+            return left + (node->color == Color::Black ? 1 : 0);
+        }
+
 
     protected: // utilities for inheriting classes
         Iterator iter(Node* node)
@@ -31,7 +31,7 @@ namespace trb
         if constexpr(!NodeT::threaded)
         {
             if (node->left != nil)
-                return tree_max(nil, node->left);
+                return tree_max<NodeT>(nil, node->left);
 
             NodeT* pred = node->parent;
             while (pred != nil && node == pred->left)
@@ -55,7 +55,7 @@ namespace trb
         {
             if (node->right != nil)
             {
-                return tree_min(nil, node->right);
+                return tree_min<NodeT>(nil, node->right);
             }
 
             NodeT* succ = node->parent;
@@ -124,6 +124,163 @@ namespace trb
         return count;
     }
 
+    // order statistics, available only for counted nodes
+    template<class NodeT>
+    u32 subtree_size(NodeT* node)
+    {
+        static_assert(NodeT::counted, "Node must be counted.");
+
+        return node->subtree.size;
+    }
+
+    // NOTE : node != NIL, recomputes size and summary (see NodeSummary) of the subtree from the children
+    template<class NodeT>
+    void update_subtree(NodeT* nil, NodeT* node)
+    {
+        if constexpr(NodeT::counted)
+        {
+            assert(node != nil);
+
+            node->subtree.size = node->left->subtree.size + node->right->subtree.size + 1;
+        }
+        if constexpr(NodeT::augmented)
+        {
+            assert(node != nil);
+
+            using Augment = typename NodeT::Augment;
+
+            node->summary.value = Augment::combine(
+                Augment::combine(node->left->summary.value, Augment::lift(node->key)), node->right->summary.value
+            );
+        }
+    }
+
+    // NOTE : pivot takes the place of node in rotation so its subtree consists of the same keys
+    template<class NodeT>
+    void take_subtree(NodeT* pivot, NodeT* node)
+    {
+        if constexpr(NodeT::counted)
+            pivot->subtree.size = node->subtree.size;
+        if constexpr(NodeT::augmented)
+            pivot->summary.value = node->summary.value;
+    }
+
+    // NOTE : recomputes sizes and summaries from node up to the root, node can be NIL
+    template<class NodeT>
+    void update_path(NodeT* nil, NodeT* node)
+    {
+        if constexpr(NodeT::counted || NodeT::augmented)
+        {
+            while (node != nil)
+            {
+                update_subtree(nil, node);
+
+                node = node->parent;
+            }
+        }
+    }
+
+    // NOTE : returns count of nodes preceding the node, rank of NIL is size of the tree
+    template<class NodeT>
+    u32 rank(NodeT* nil, NodeT* root, NodeT* node)
+    {
+        static_assert(NodeT::counted, "Node must be counted.");
+
+        if (node == nil)
+            return root->subtree.size;
+
+        u32 r = node->left->subtree.size;
+        while (node->parent != nil)
+        {
+            if (node == node->parent->right)
+                r += node->parent->left->subtree.size + 1;
+            node = node->parent;
+        }
+        return r;
+    }
+
+    // NOTE : returns k-th node (zero-based) or NIL if k is out of range
+    template<class NodeT>
+    NodeT* select(NodeT* nil, NodeT* root, u32 k)
+    {
+        static_assert(NodeT::counted, "Node must be counted.");
+
+        while (root != nil)
+        {
+            u32 left = root->left->subtree.size;
+            if (k < left)
+            {
+                root = root->left;
+            }
+            else if (k > left)
+            {
+                k -= left + 1;
+                root = root->right;
+            }
+            else
+            {
+                break;
+            }
+        }
+        return root;
+    }
+
+    // NOTE : summary of keys in [low, high), available only for augmented nodes, O(log n)
+    // descends to the highest node in range, then folds the left part along the path to low
+    // and the right part along the path to high
+    template<class NodeT, class Compare, class Low, class High>
+    typename NodeT::Augment::Summary range_summary(NodeT* nil, NodeT* root, Compare&& compare, const Low& low, const High& high)
+    {
+        static_assert(NodeT::augmented, "Node must be augmented.");
+
+        using Augment = typename NodeT::Augment;
+
+        NodeT* split = root;
+        while (split != nil)
+        {
+            if (compare(split->key, low))
+                split = split->right;
+            else if (!compare(split->key, high))
+                split = split->left;
+            else
+                break;
+        }
+        if (split == nil)
+            return Augment::identity();
+
+        // keys >= low in the left subtree, each found part precedes the previous ones
+        auto left = Augment::identity();
+        for (NodeT* node = split->left; node != nil;)
+        {
+            if (compare(node->key, low))
+            {
+                node = node->right;
+            }
+            else
+            {
+                left = Augment::combine(Augment::combine(Augment::lift(node->key), node->right->summary.value), left);
+                node = node->left;
+            }
+        }
+
+        // keys < high in the right subtree, each found part follows the previous ones
+        auto right = Augment::identity();
+        for (NodeT* node = split->right; node != nil;)
+        {
+            if (compare(node->key, high))
+            {
+                right = Augment::combine(right, Augment::combine(node->left->summary.value, Augment::lift(node->key)));
+                node = node->right;
+            }
+            else
+            {
+                node = node->left;
+            }
+        }
+
+        return Augment::combine(Augment::combine(left, Augment::lift(split->key)), right);
+    }
+
     // NOTE : node != NIL, node->right != NIL
     template<class NodeT>
     NodeT* rotate_left(NodeT* nil, NodeT* root, NodeT* node)
@@ -131,7 +288,7 @@ namespace trb
         assert(node != nil);
         assert(node->right != nil);
 
-        auto pivot = node->right;
+        NodeT* pivot = node->right;
 
         node->right = pivot->left;
 
@@ -154,6 +311,9 @@ namespace trb
         pivot->parent = node->parent;
         node->parent = pivot;
 
+        take_subtree(pivot, node);
+        update_subtree(nil, node);
+
         return root;
     }
 
@@ -164,7 +324,7 @@ namespace trb
         assert(node != nil);
         assert(node->left != nil);
 
-        auto pivot = node->left;
+        NodeT* pivot = node->left;
 
         node->left = pivot->right;
         pivot->right = node;
@@ -186,6 +346,9 @@ namespace trb
         pivot->parent = node->parent;
         node->parent = pivot;
 
+        take_subtree(pivot, node);
+        update_subtree(nil, node);
+
         return root;
     }
 
@@ -244,14 +407,16 @@ namespace trb
 
 
 
+    // NOTE : node is red, resolves possible red-red violation between node and its parent
+    // root is not recolored so it can become red, see fix_insert
     template<class NodeT>
-    NodeT* fix_insert(NodeT* nil, NodeT* root, NodeT* node)
+    NodeT* fix_red_red(NodeT* nil, NodeT* root, NodeT* node)
     {
         while (node->parent->color == Color::Red)
         {
             if (node->parent == node->parent->parent->left)
             {
-                auto uncle = node->parent->parent->right;
+                NodeT* uncle = node->parent->parent->right;
                 if (uncle->color == Color::Red)
                 {
                     node->parent->color = Color::Black;
@@ -272,12 +437,12 @@ namespace trb
                     node->parent->color = Color::Black;
                     node->parent->parent->color = Color::Red;
 
-                    root = rotate_right(nil, root, node->parent->parent);
+                    root = rotate_right<NodeT>(nil, root, node->parent->parent);
                 }
             }
             else
             {
-                auto uncle = node->parent->parent->left;
+                NodeT* uncle = node->parent->parent->left;
                 if (uncle->color == Color::Red)
                 {
                     node->parent->color = Color::Black;
@@ -298,11 +463,19 @@ namespace trb
                     node->parent->color = Color::Black;
                     node->parent->parent->color = Color::Red;
 
-                    root = rotate_left(nil, root, node->parent->parent);
+                    root = rotate_left<NodeT>(nil, root, node->parent->parent);
                 }
             }
         }
 
+        return root;
+    }
+
+    template<class NodeT>
+    NodeT* fix_insert(NodeT* nil, NodeT* root, NodeT* node)
+    {
+        root = fix_red_red(nil, root, node);
+
         root->color = Color::Black;
 
         return root;
@@ -332,6 +505,8 @@ namespace trb
         node->left = nil;
         node->right = nil;
 
+        update_path<NodeT>(nil, node);
+
         return fix_insert(nil, root, node);
     }
 
@@ -385,6 +560,8 @@ namespace trb
 
         node->color = Color::Red;
 
+        update_path<NodeT>(nil, node);
+
         return fix_insert(nil, root, node);
     }
 
@@ -420,6 +597,8 @@ namespace trb
             after->next = node;
         }
 
+        update_path<NodeT>(nil, node);
+
         return fix_insert(nil, root, node);
     }
 
@@ -455,6 +634,8 @@ namespace trb
             before->prev = node;
         }
 
+        update_path<NodeT>(nil, node);
+
         return fix_insert(nil, root, node);
     }
 
@@ -474,34 +655,37 @@ namespace trb
             root = trans;
         }
 
-        trans->parent = node->parent;
+        if (trans != nil)
+            trans->parent = node->parent;
 
         return root;
     }
 
+    // NOTE : parent of restore is passed explicitly (restore can be NIL), NIL is never written to
     template<class NodeT>
-    NodeT* fix_remove(NodeT* nil, NodeT* root, NodeT* restore)
+    NodeT* fix_remove(NodeT* nil, NodeT* root, NodeT* restore, NodeT* parent)
     {
         while (restore != root && restore->color == Color::Black)
         {
-            if (restore == restore->parent->left)
+            if (restore == parent->left)
             {
-                auto brother = restore->parent->right;
+                NodeT* brother = parent->right;
                 if (brother->color == Color::Red)
                 {
                     brother->color = Color::Black;
-                    restore->parent->color = Color::Red;
+                    parent->color = Color::Red;
 
-                    root = rotate_left(nil, root, restore->parent);
+                    root = rotate_left(nil, root, parent);
 
-                    brother = restore->parent->right;
+                    brother = parent->right;
                 }
 
                 if (brother->left->color == Color::Black && brother->right->color == Color::Black)
                 {
                     brother->color = Color::Red;
 
-                    restore = restore->parent;
+                    restore = parent;
+                    parent = restore->parent;
                 }
                 else
                 {
@@ -512,36 +696,37 @@ namespace trb
 
                         root = rotate_right(nil, root, brother);
 
-                        brother = restore->parent->right;
+                        brother = parent->right;
                     }
 
-                    brother->color = restore->parent->color;
-                    restore->parent->color = Color::Black;
+                    brother->color = parent->color;
+                    parent->color = Color::Black;
                     brother->right->color = Color::Black;
 
-                    root = rotate_left(nil, root, restore->parent);
+                    root = rotate_left(nil, root, parent);
 
                     restore = root;
                 }
             }
             else
             {
-                auto brother = restore->parent->left;
+                NodeT* brother = parent->left;
                 if (brother->color == Color::Red)
                 {
                     brother->color = Color::Black;
-                    restore->parent->color = Color::Red;
+                    parent->color = Color::Red;
 
-                    root = rotate_right(nil, root, restore->parent);
+                    root = rotate_right(nil, root, parent);
 
-                    brother = restore->parent->left;
+                    brother = parent->left;
                 }
 
                 if (brother->left->color == Color::Black && brother->right->color == Color::Black)
                 {
                     brother->color = Color::Red;
 
-                    restore = restore->parent;
+                    restore = parent;
+                    parent = restore->parent;
                 }
                 else
                 {
@@ -552,21 +737,22 @@ namespace trb
 
                         root = rotate_left(nil, root, brother);
 
-                        brother = restore->parent->left;
+                        brother = parent->left;
                     }
 
-                    brother->color = restore->parent->color;
-                    restore->parent->color = Color::Black;
+                    brother->color = parent->color;
+                    parent->color = Color::Black;
                     brother->left->color = Color::Black;
 
-                    root = rotate_right(nil, root, restore->parent);
+                    root = rotate_right(nil, root, parent);
 
                     restore = root;
                 }
             }
         }
 
-        restore->color = Color::Black;
+        if (restore != nil)
+            restore->color = Color::Black;
 
         return root;
     }
@@ -578,33 +764,33 @@ namespace trb
 
         Color removed = node->color;
         NodeT* restore = nil;
+        NodeT* parent  = node->parent;
 
         if (node->left == nil)
         {
             restore = node->right;
 
-            root = transplant(nil, root, node, node->right);
+            root = transplant<NodeT>(nil, root, node, node->right);
         }
         else if (node->right == nil)
         {
             restore = node->left;
 
-            root = transplant(nil, root, node, node->left);
+            root = transplant<NodeT>(nil, root, node, node->left);
         }
         else
         {
-            auto leftmost = tree_min(nil, node->right);
+            auto leftmost = tree_min<NodeT>(nil, node->right);
 
             removed = leftmost->color;
             restore = leftmost->right;
-            if (restore == nil)
-            {
-                restore->parent = leftmost;
-            }
+            parent  = leftmost;
 
             if (node->right != leftmost)
             {
-                root = transplant(nil, root, leftmost, leftmost->right);
+                parent = leftmost->parent;
+
+                root = transplant<NodeT>(nil, root, leftmost, leftmost->right);
 
                 leftmost->right = node->right;
                 node->right->parent = leftmost;
@@ -618,13 +804,14 @@ namespace trb
             leftmost->color = node->color;
         }
 
+        // parent is the lowest node whose subtree has changed
+        update_path(nil, parent);
+
         if (removed == Color::Black)
         {
-            root = fix_remove(nil, root, restore);
+            root = fix_remove(nil, root, restore, parent);
         }
 
-        nil->parent = nil;
-
         return root;
     }
 
@@ -635,33 +822,33 @@ namespace trb
 
         Color removed = node->color;
         NodeT* restore = nil;
+        NodeT* parent  = node->parent;
 
         if (node->left == nil)
         {
             restore = node->right;
 
-            root = transplant(nil, root, node, node->right);
+            root = transplant<NodeT>(nil, root, node, node->right);
         }
         else if (node->right == nil)
         {
             restore = node->left;
 
-            root = transplant(nil, root, node, node->left);
+            root = transplant<NodeT>(nil, root, node, node->left);
         }
         else
         {
-            auto leftmost = node->next;
+            NodeT* leftmost = node->next;
 
             removed = leftmost->color;
             restore = leftmost->right;
-            if (restore == nil)
-            {
-                restore->parent = leftmost;
-            }
+            parent  = leftmost;
 
             if (node->right != leftmost)
             {
-                root = transplant(nil, root, leftmost, leftmost->right);
+                parent = leftmost->parent;
+
+                root = transplant<NodeT>(nil, root, leftmost, leftmost->right);
 
                 leftmost->right = node->right;
                 node->right->parent = leftmost;
@@ -675,28 +862,208 @@ namespace trb
             leftmost->color = node->color;
         }
 
+        // parent is the lowest node whose subtree has changed
+        update_path(nil, parent);
+
         if (removed == Color::Black)
         {
-            root = fix_remove(nil, root, restore);
+            root = fix_remove(nil, root, restore, parent);
         }
 
         // list remove
         node->prev->next = node->next;
         node->next->prev = node->prev;
 
-        nil->parent = nil;
+        return root;
+    }
+
+
+    // join & split
+    // NOTE : nodes must share NIL, threaded nodes are not supported (list would have to be relinked)
+    // black heights of the trees (see black_height) are passed explicitly so split doesn't recompute them
+
+    // NOTE : node != NIL, node is detached, all keys of left precede node->key, node->key precedes all keys of right
+    // left and right can be subtrees of some tree, their roots are detached and blackened
+    // height is set to the black height of the resulting tree
+    template<class NodeT>
+    NodeT* join(NodeT* nil, NodeT* left, u32 leftHeight, NodeT* node, NodeT* right, u32 rightHeight, u32& height)
+    {
+        static_assert(!NodeT::threaded, "Threaded nodes are not supported.");
+
+        assert(node != nil);
+
+        if (left != nil)
+        {
+            left->parent = nil;
+            if (left->color == Color::Red)
+            {
+                left->color = Color::Black;
+                ++leftHeight;
+            }
+        }
+
+        if (right != nil)
+        {
+            right->parent = nil;
+            if (right->color == Color::Red)
+            {
+                right->color = Color::Black;
+                ++rightHeight;
+            }
+        }
+
+        if (leftHeight == rightHeight)
+        {
+            node->parent = nil;
+            node->left   = left;
+            node->right  = right;
+            node->color  = Color::Black;
+            if (left != nil)
+                left->parent = node;
+            if (right != nil)
+                right->parent = node;
+
+            update_subtree(nil, node);
+
+            height = leftHeight + 1;
+
+            return node;
+        }
+
+        NodeT* root = nil;
+        if (leftHeight > rightHeight)
+        {
+            // descend along the right spine of the left tree to the black node with the same black height as the right tree
+            NodeT* parent = nil;
+            NodeT* curr   = left;
+            u32 currHeight = leftHeight;
+            while (currHeight != rightHeight || curr->color != Color::Black)
+            {
+                if (curr->color == Color::Black)
+                    --currHeight;
+                parent = curr;
+                curr = curr->right;
+            }
+
+            parent->right = node;
+            node->parent = parent;
+            node->left   = curr;
+            node->right  = right;
+
+            root   = left;
+            height = leftHeight;
+        }
+        else
+        {
+            // descend along the left spine of the right tree
+            NodeT* parent = nil;
+            NodeT* curr   = right;
+            u32 currHeight = rightHeight;
+            while (currHeight != leftHeight || curr->color != Color::Black)
+            {
+                if (curr->color == Color::Black)
+                    --currHeight;
+                parent = curr;
+                curr = curr->left;
+            }
+
+            parent->left = node;
+            node->parent = parent;
+            node->left   = left;
+            node->right  = curr;
+
+            root   = right;
+            height = rightHeight;
+        }
+
+        node->color = Color::Red;
+        if (node->left != nil)
+            node->left->parent = node;
+        if (node->right != nil)
+            node->right->parent = node;
+
+        update_subtree(nil, node);
+        update_path<NodeT>(nil, node->parent);
+
+        root = fix_red_red(nil, root, node);
+        if (root->color == Color::Red)
+        {
+            root->color = Color::Black;
+            ++height;
+        }
 
         return root;
     }
 
+    template<class NodeT>
+    NodeT* join(NodeT* nil, NodeT* left, NodeT* node, NodeT* right)
+    {
+        u32 height{};
+        return join(nil, left, black_height(nil, left), node, right, black_height(nil, right), height);
+    }
+
+    // NOTE : concatenation, all keys of left precede all keys of right
+    template<class NodeT>
+    NodeT* join(NodeT* nil, NodeT* left, NodeT* right)
+    {
+        if (right == nil)
+            return left;
+
+        NodeT* node = tree_min(nil, right);
+        right = remove(nil, right, node);
+        return join(nil, left, node, right);
+    }
+
+    // NOTE : splits tree into two: left gets nodes with keys satisfying precedes(key), right gets the rest
+    // precedes must be monotone: true for some prefix of the keys and false for the rest
+    // height is the black height of the tree, O(log n)
+    template<class NodeT, class Precedes>
+    void split(NodeT* nil, NodeT* root, u32 height, Precedes&& precedes, NodeT*& left, u32& leftHeight, NodeT*& right, u32& rightHeight)
+    {
+        if (root == nil)
+        {
+            left  = nil;
+            right = nil;
+            leftHeight  = 0;
+            rightHeight = 0;
+            return;
+        }
+
+        u32 childHeight = height - (root->color == Color::Black ? 1 : 0);
+
+        NodeT* rootLeft  = root->left;
+        NodeT* rootRight = root->right;
+        if (precedes(root->key))
+        {
+            NodeT* middle{};
+            u32 middleHeight{};
+            split(nil, rootRight, childHeight, precedes, middle, middleHeight, right, rightHeight);
+            left = join(nil, rootLeft, childHeight, root, middle, middleHeight, leftHeight);
+        }
+        else
+        {
+            NodeT* middle{};
+            u32 middleHeight{};
+            split(nil, rootLeft, childHeight, precedes, left, leftHeight, middle, middleHeight);
+            right = join(nil, middle, middleHeight, root, rootRight, childHeight, rightHeight);
+        }
+    }
+
+    template<class NodeT, class Precedes>
+    void split(NodeT* nil, NodeT* root, Precedes&& precedes, NodeT*& left, NodeT*& right)
+    {
+        u32 leftHeight{};
+        u32 rightHeight{};
+        split(nil, root, black_height(nil, root), std::forward<Precedes>(precedes), left, leftHeight, right, rightHeight);
+    }
 
     template<class NodeT, class CleanUp>
     void clear(NodeT* nil, NodeT* root, CleanUp&& cleanUp)
     {
         if (root != nil)
         {
-            clear(nil, root->left , std::forward<CleanUp>(cleanUp));
-            clear(nil, root->right, std::forward<CleanUp>(cleanUp));
+            clear<NodeT>(nil, root->left , std::forward<CleanUp>(cleanUp));
+            clear<NodeT>(nil, root->right, std::forward<CleanUp>(cleanUp));
 
             cleanUp(root);
         }